@@ -0,0 +1,193 @@
+///Checks the number of heap allocations made by common parsing paths, by
+///replacing the global allocation functions with counting versions. These
+///budgets catch changes which add allocations to the hot paths, which the
+///behavioral tests in test.cpp cannot notice.
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <unistd.h>
+#include "cl_options.h"
+
+#ifdef __GLIBC__
+extern "C"{
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+}
+#endif
+
+namespace{
+///the number of allocations made while counting is enabled
+size_t allocations=0;
+bool counting=false;
+
+void* countedAllocate(size_t size){
+	if(counting)
+		allocations++;
+#ifdef __GLIBC__
+	//bypass the counting malloc below, so that this is counted only once
+	void* p=__libc_malloc(size?size:1);
+#else
+	void* p=std::malloc(size?size:1);
+#endif
+	if(!p)
+		throw std::bad_alloc();
+	return(p);
+}
+}
+
+void* operator new(size_t size){ return(countedAllocate(size)); }
+void* operator new[](size_t size){ return(countedAllocate(size)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+	try{
+		return(countedAllocate(size));
+	}catch(std::bad_alloc&){
+		return(nullptr);
+	}
+}
+void* operator new[](size_t size, const std::nothrow_t& nt) noexcept{ return(operator new(size,nt)); }
+void operator delete(void* p) noexcept{ std::free(p); }
+void operator delete[](void* p) noexcept{ std::free(p); }
+void operator delete(void* p, size_t) noexcept{ std::free(p); }
+void operator delete[](void* p, size_t) noexcept{ std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept{ std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept{ std::free(p); }
+
+#ifdef __GLIBC__
+//Also count direct calls to malloc, by interposing on glibc's implementation
+extern "C"{
+void* malloc(size_t size){
+	if(counting)
+		allocations++;
+	return(__libc_malloc(size));
+}
+void* calloc(size_t count, size_t size){
+	if(counting)
+		allocations++;
+	return(__libc_calloc(count,size));
+}
+void* realloc(void* p, size_t size){
+	if(counting)
+		allocations++;
+	return(__libc_realloc(p,size));
+}
+}
+#endif
+
+///Count the allocations made by a function
+template<typename Function>
+size_t countAllocations(Function f){
+	allocations=0;
+	counting=true;
+	f();
+	counting=false;
+	return(allocations);
+}
+
+size_t failures=0;
+
+void requireBudget(const char* name, size_t count, size_t budget){
+	if(count>budget){
+		std::cout << name << ":\n\t" << count << " allocations exceeds the budget of "
+		  << budget << std::endl;
+		failures++;
+	}
+}
+
+///The options used by most checks: flags, and values with destinations which
+///do not need to allocate
+struct Fixture{
+	OptionParser op;
+	bool verbose, quiet;
+	int count;
+	long long offset;
+	double ratio;
+	std::string name;
+
+	Fixture():op(false),verbose(false),quiet(false),count(0),offset(0),ratio(0){
+		op.addOption({"v","verbose"},[this]{ verbose=true; },"Print more");
+		op.addOption({"q","quiet"},[this]{ quiet=true; },"Print less");
+		op.addOption({"n","count"},count,"A count");
+		op.addOption("offset",offset,"An offset");
+		op.addOption({"r","ratio"},ratio,"A ratio");
+		op.addOption("name",name,"A name");
+		op.allowsShortOptionCombination(true);
+		//long enough for any value used below
+		name.reserve(64);
+		op.freeze();
+	}
+};
+
+const char* flagArgs[]={"program","-v","--quiet","-vq","--verbose"};
+const size_t flagArgCount=sizeof(flagArgs)/sizeof(flagArgs[0]);
+const char* valueArgs[]={"program","-n","12","--offset=-400000000000","-r0.25","--ratio","1e-3",
+                         "--name=a name longer than any short string buffer"};
+const size_t valueArgCount=sizeof(valueArgs)/sizeof(valueArgs[0]);
+
+void check_flags(){
+	Fixture f;
+	//the list of positionals, which holds the short program name
+	requireBudget("flags",countAllocations([&]{ f.op.parseArgs(flagArgCount,flagArgs); }),1);
+	requireBudget("flags as views",countAllocations([&]{ f.op.parseArgsAsViews(flagArgCount,flagArgs); }),1);
+	//the hidden statistics option costs nothing unless it is used
+	f.op.allowsStatisticsOption(true);
+	requireBudget("flags with statistics allowed",countAllocations([&]{ f.op.parseArgs(flagArgCount,flagArgs); }),1);
+}
+
+void check_values(){
+	Fixture f;
+	requireBudget("values",countAllocations([&]{ f.op.parseArgs(valueArgCount,valueArgs); }),1);
+	if(f.count!=12 || f.offset!=-400000000000LL || f.ratio!=1e-3 || f.name.size()!=42){
+		std::cout << "values:\n\tincorrect values parsed" << std::endl;
+		failures++;
+	}
+}
+
+void check_config_file(){
+	Fixture f;
+	f.op.addConfigFileOption('c',"Read config from a file");
+	f.op.freeze();
+	{
+		std::ofstream out(".alloc_test_conf");
+		out << "-v -n 7 --ratio=0.5 --offset 9\n-q positional";
+	}
+	const char* args[]={"program","-c",".alloc_test_conf"};
+	//the positionals (twice, as they grow), the file path and its copy in the
+	//token cache, the file stack, the node and buckets of both the set of
+	//files being read and the token cache, the cached text, and the token
+	//offsets (four times, as they grow)
+	requireBudget("config file",countAllocations([&]{ f.op.parseArgs(3,args); }),14);
+	unlink(".alloc_test_conf");
+}
+
+void check_session(){
+	Fixture f;
+	OptionParser::Session session(f.op);
+	session.parse(valueArgCount,valueArgs);
+	requireBudget("session flags",countAllocations([&]{ session.parse(flagArgCount,flagArgs); }),0);
+	requireBudget("session values",countAllocations([&]{ session.parse(valueArgCount,valueArgs); }),0);
+
+	//with memory reserved in advance, not even the first parse allocates
+	OptionParser::Session reserved(f.op,4096);
+	requireBudget("reserved session",countAllocations([&]{
+		reserved.parse(valueArgCount,valueArgs);
+		reserved.parse(flagArgCount,flagArgs);
+	}),0);
+}
+
+#define DO_CHECK(check) \
+	check()
+
+int main(){
+	DO_CHECK(check_flags);
+	DO_CHECK(check_values);
+	DO_CHECK(check_config_file);
+	DO_CHECK(check_session);
+
+	if(!failures)
+		std::cout << "Allocation test successful" << std::endl;
+	else
+		std::cout << failures << (failures==1?" failure":" failures") << std::endl;
+	return(failures?1:0);
+}
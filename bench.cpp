@@ -0,0 +1,342 @@
+///Benchmarks for the hot paths of cl_options.h: option registration, argument
+///parsing, tokenization of configuration files, value conversion, help text
+///rendering, and pathological inputs. Results are written as JSON (or CSV, with
+///--format=csv) so that they can be compared between versions of the header.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+#include "cl_options.h"
+
+namespace{
+
+using Clock=std::chrono::steady_clock;
+
+///Prevents the compiler from discarding the results of benchmarked code
+volatile size_t sink;
+
+struct Result{
+	std::string name;
+	///the number of operations performed
+	uint64_t operations;
+	///the total time taken, in seconds
+	double seconds;
+	///the number of bytes processed by each operation, or zero if not relevant
+	uint64_t bytesPerOperation;
+};
+
+struct Harness{
+	double minTime;
+	std::string filter;
+	std::vector<Result> results;
+
+	bool selected(const std::string& name) const{
+		return(filter.empty() || name.find(filter)!=std::string::npos);
+	}
+
+	///Time a function repeatedly, increasing the number of repetitions until
+	///the total time is at least minTime
+	///\param operationsPerCall the number of operations performed by one call
+	///\param bytesPerOperation the number of bytes processed by each operation
+	template<typename Function>
+	void run(const std::string& name, uint64_t operationsPerCall, uint64_t bytesPerOperation, Function f){
+		if(!selected(name))
+			return;
+		f(); //warm up
+		uint64_t calls=1;
+		while(true){
+			Clock::time_point start=Clock::now();
+			for(uint64_t i=0; i<calls; i++)
+				f();
+			double seconds=std::chrono::duration<double>(Clock::now()-start).count();
+			if(seconds>=minTime || calls>=(uint64_t(1)<<40)){
+				results.push_back(Result{name,calls*operationsPerCall,seconds,bytesPerOperation});
+				return;
+			}
+			//aim somewhat beyond the minimum time to avoid many short rounds
+			double scale=(seconds>0 ? 1.5*minTime/seconds : 100);
+			calls=std::max(calls+1,(uint64_t)(calls*std::min(scale,100.)));
+		}
+	}
+
+	void writeJSON(std::ostream& os) const{
+		os << "{\n  \"benchmarks\": [";
+		for(size_t i=0; i<results.size(); i++){
+			const Result& r=results[i];
+			double nsPerOp=1e9*r.seconds/r.operations;
+			os << (i?",":"") << "\n    {\"name\": \"" << r.name << "\", \"operations\": " << r.operations
+			   << ", \"seconds\": " << r.seconds << ", \"ns_per_op\": " << nsPerOp
+			   << ", \"ops_per_sec\": " << r.operations/r.seconds;
+			if(r.bytesPerOperation)
+				os << ", \"bytes_per_sec\": " << r.bytesPerOperation*r.operations/r.seconds;
+			os << "}";
+		}
+		os << "\n  ]\n}\n";
+	}
+
+	void writeCSV(std::ostream& os) const{
+		os << "name,operations,seconds,ns_per_op,ops_per_sec,bytes_per_sec\n";
+		for(const Result& r : results){
+			os << r.name << ',' << r.operations << ',' << r.seconds << ','
+			   << 1e9*r.seconds/r.operations << ',' << r.operations/r.seconds << ',';
+			if(r.bytesPerOperation)
+				os << r.bytesPerOperation*r.operations/r.seconds;
+			os << '\n';
+		}
+	}
+};
+
+///Generate a distinct long option name
+std::string optionName(size_t i){
+	return("option-"+std::to_string(i));
+}
+
+void benchRegistration(Harness& h){
+	for(size_t count : {10, 100, 1000}){
+		std::vector<int> destinations(count);
+		std::vector<std::string> names;
+		for(size_t i=0; i<count; i++)
+			names.push_back(optionName(i));
+		//registration is only complete once the lookup tables are built
+		h.run("register/"+std::to_string(count),count,0,[&]{
+			OptionParser op(false);
+			for(size_t i=0; i<count; i++)
+				op.addOption(names[i],destinations[i],"An option");
+			op.freeze();
+			sink=op.isFrozen();
+		});
+	}
+}
+
+///An option parser with a mixture of short and long options
+struct ParsingFixture{
+	OptionParser op;
+	bool flags[26];
+	int number;
+	std::string name;
+	double ratio;
+
+	ParsingFixture():op(false),number(0),ratio(0){
+		for(char c='a'; c<='m'; c++){
+			bool* flag=&flags[c-'a'];
+			op.addOption(c,[flag]{ *flag=true; },"A flag");
+			op.addOption(std::string("flag-")+c,[flag]{ *flag=true; },"A flag");
+		}
+		op.addOption({"n","number"},number,"A number");
+		op.addOption({"s","name"},name,"A name");
+		op.addOption({"r","ratio"},ratio,"A ratio");
+		op.allowsShortOptionCombination(true);
+		op.freeze();
+	}
+};
+
+void benchParsing(Harness& h){
+	ParsingFixture fixture;
+	auto runParse=[&](const std::string& name, const std::vector<std::string>& args){
+		std::vector<const char*> argv;
+		for(const std::string& arg : args)
+			argv.push_back(arg.c_str());
+		h.run(name,args.size(),0,[&]{
+			sink=fixture.op.parseArgs(argv.size(),argv.data()).size();
+		});
+	};
+
+	std::vector<std::string> shortArgs={"program"}, combinedArgs={"program"}, longArgs={"program"};
+	for(int i=0; i<8; i++){
+		for(char c='a'; c<='m'; c++){
+			shortArgs.push_back(std::string("-")+c);
+			longArgs.push_back(std::string("--flag-")+c);
+		}
+		combinedArgs.push_back("-abcdefghijklm");
+		shortArgs.insert(shortArgs.end(),{"-n=17","-s=name","-r=0.5"});
+		combinedArgs.insert(combinedArgs.end(),{"-n17","-sname","-r0.5"});
+		longArgs.insert(longArgs.end(),{"--number=17","--name","name","--ratio=0.5"});
+		shortArgs.push_back("positional");
+		combinedArgs.push_back("positional");
+		longArgs.push_back("positional");
+	}
+	runParse("parse/short",shortArgs);
+	runParse("parse/combined",combinedArgs);
+	runParse("parse/long",longArgs);
+}
+
+///Write a configuration file of roughly a given size with a realistic mix
+///of options, quoting, and comments-free whitespace
+std::string makeConfig(size_t targetSize){
+	std::string text;
+	for(size_t i=0; text.size()<targetSize; i++){
+		text+="--number ";
+		text+=std::to_string(i);
+		text+=" --name 'some quoted name ";
+		text+=std::to_string(i);
+		text+="'\n\t-abc --ratio=0.";
+		text+=std::to_string(i%1000);
+		text+=" \"a \\\"double\\\" quoted positional\" plain/positional/path.o\n";
+	}
+	return(text);
+}
+
+void benchTokenizing(Harness& h){
+	ParsingFixture fixture;
+	const size_t size=4<<20;
+	std::string text=makeConfig(size);
+	char path[]="/tmp/cl_options_bench_XXXXXX";
+	int fd=mkstemp(path);
+	if(fd<0){
+		std::cerr << "Unable to create a temporary file; skipping tokenizer benchmarks" << std::endl;
+		return;
+	}
+	if(write(fd,text.data(),text.size())!=(ssize_t)text.size())
+		std::cerr << "Unable to write the temporary file" << std::endl;
+	close(fd);
+	h.run("tokenize/file_4MiB",1,text.size(),[&]{
+		sink=fixture.op.parseArgsFromFile(path).size();
+	});
+	h.run("tokenize/stream_4MiB",1,text.size(),[&]{
+		std::istringstream ss(text);
+		sink=fixture.op.parseArgsFromStream(ss).size();
+	});
+	unlink(path);
+}
+
+///Inputs chosen to be as expensive as possible to parse, as might be
+///submitted by a hostile user
+void benchWorstCases(Harness& h){
+	OptionParser op(false);
+	size_t flags=0;
+	std::string name;
+	op.addOption('v',[&]{ flags++; },"A flag");
+	op.addOption("name",name,"A name");
+	op.addConfigFileOption('c',"Read config from a file");
+	op.allowsShortOptionCombination(true);
+	op.freeze();
+	
+	std::string group="-"+std::string(1<<20,'v');
+	const char* groupArgs[]={"program",group.c_str()};
+	h.run("worst_case/combined_flags_1M",1,group.size(),[&]{
+		sink=op.parseArgs(2,groupArgs).size();
+	});
+	
+	std::string longToken="--name '"+std::string(4<<20,'x')+"'";
+	h.run("worst_case/long_token_4MiB",1,longToken.size(),[&]{
+		std::istringstream ss(longToken);
+		sink=op.parseArgsFromStream(ss).size();
+	});
+	
+	std::vector<const char*> manyArgs(1<<20,"-v");
+	h.run("worst_case/many_arguments_1M",manyArgs.size(),0,[&]{
+		sink=op.parseArgs(manyArgs.size(),manyArgs.data()).size();
+	});
+	
+	//a chain of configuration files, each including the next, as deep as 
+	//the default limit allows
+	char dir[]="/tmp/cl_options_bench_XXXXXX";
+	if(!mkdtemp(dir)){
+		std::cerr << "Unable to create a temporary directory; skipping nested configuration benchmark" << std::endl;
+		return;
+	}
+	const size_t depth=op.maxIncludeDepth();
+	std::vector<std::string> paths;
+	for(size_t i=0; i<depth; i++)
+		paths.push_back(std::string(dir)+"/"+std::to_string(i)+".conf");
+	for(size_t i=0; i<depth; i++){
+		std::ofstream out(paths[i]);
+		out << "-v";
+		if(i+1<depth)
+			out << " -c " << paths[i+1];
+	}
+	h.run("worst_case/nested_config_"+std::to_string(depth),depth,0,[&]{
+		sink=op.parseArgsFromFile(paths.front()).size();
+	});
+	for(const std::string& path : paths)
+		unlink(path.c_str());
+	rmdir(dir);
+}
+
+template<typename T>
+void benchConversion(Harness& h, const std::string& type, std::vector<std::string> inputs){
+	h.run("convert/"+type,inputs.size(),0,[&]{
+		T value;
+		size_t ok=0;
+		for(const std::string& input : inputs)
+			ok+=OptionValueConverter<T>::convert(input.data(),input.data()+input.size(),value);
+		sink=ok;
+	});
+}
+
+void benchConversions(Harness& h){
+	benchConversion<int>(h,"int",{"0","17","-2048","123456789","-99"});
+	benchConversion<unsigned long long>(h,"unsigned_long_long",{"0","18446744073709551615","42","1000000"});
+	benchConversion<double>(h,"double",{"0.5","-1e10","3.14159265358979","2.5e-300","1000"});
+	benchConversion<float>(h,"float",{"0.5","-1e10","3.14159","2.5e-30","1000"});
+	benchConversion<bool>(h,"bool",{"true","false","true","false"});
+	benchConversion<char>(h,"char",{"a","b","c","d"});
+	benchConversion<std::string>(h,"string",{"short","a somewhat longer string value beyond SSO"});
+}
+
+void benchUsage(Harness& h){
+	for(size_t count : {10, 100}){
+		OptionParser op;
+		op.setBaseUsage("A benchmark of help text rendering");
+		std::vector<int> destinations(count);
+		for(size_t i=0; i<count; i++)
+			op.addOption(optionName(i),destinations[i],
+			  "An option with a moderately long description, which will need to be wrapped "
+			  "when the help text is rendered for a narrow terminal","n");
+		for(size_t width : {0, 80}){
+			h.run("usage/"+std::to_string(count)+"_options_width_"+std::to_string(width),1,0,[&]{
+				//changing a setting forces the text to be rendered again
+				op.usesANSICodes(false);
+				sink=op.getUsage(width).size();
+			});
+		}
+	}
+}
+
+}
+
+int main(int argc, char* argv[]){
+	OptionParser op;
+	op.setBaseUsage("Usage: bench [options]\nRun the cl_options benchmarks");
+	std::string format="json", output;
+	Harness harness{0.2,std::string(),{}};
+	op.addOption("format",format,"The output format, json or csv","format");
+	op.addOption("min-time",harness.minTime,"The minimum time to run each benchmark, in seconds","seconds");
+	op.addOption("filter",harness.filter,"Run only benchmarks whose names contain this text","text");
+	op.addOption({"o","output"},output,"Write results to this file rather than standard output","file");
+	try{
+		op.parseArgs(argc,argv);
+	}catch(std::runtime_error& err){
+		std::cerr << err.what() << std::endl;
+		return(1);
+	}
+	if(op.didPrintUsage())
+		return(0);
+	if(format!="json" && format!="csv"){
+		std::cerr << "Unknown format: " << format << std::endl;
+		return(1);
+	}
+
+	benchRegistration(harness);
+	benchParsing(harness);
+	benchTokenizing(harness);
+	benchWorstCases(harness);
+	benchConversions(harness);
+	benchUsage(harness);
+
+	std::ofstream file;
+	if(!output.empty()){
+		file.open(output);
+		if(!file){
+			std::cerr << "Unable to write " << output << std::endl;
+			return(1);
+		}
+	}
+	std::ostream& os=(output.empty()?std::cout:file);
+	if(format=="json")
+		harness.writeJSON(os);
+	else
+		harness.writeCSV(os);
+	return(0);
+}
@@ -26,16 +26,282 @@
 #define CL_OPTIONS_H
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iterator>
 #include <iostream>
-#include <map>
-#include <set>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <new>
 #include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+	#define CL_OPTIONS_POSIX 1
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/ioctl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#ifdef __APPLE__
+		#include <crt_externs.h>
+	#else
+		//not declared by all systems' headers
+		extern "C" { extern char** environ; }
+	#endif
+#endif
+#ifdef __linux__
+	#define CL_OPTIONS_INOTIFY 1
+	#include <sys/inotify.h>
+#endif
+
+#if defined(__SSE2__) && !defined(CL_OPTIONS_NO_SIMD)
+	#define CL_OPTIONS_USE_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+#if __cplusplus>=201703L && defined(__has_include)
+	#if __has_include(<charconv>)
+		#include <charconv>
+		//floating point support is only indicated by this macro
+		#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars>=201611L
+			#define CL_OPTIONS_USE_FROM_CHARS 1
+		#endif
+	#endif
+#endif
+
+///Converts the text of an option value to a value of type T. 
+///
+/// This generic version reads the value with `operator>>` from a stream (with
+/// `std::boolalpha` set). Specializations avoid streams for integer and 
+/// floating point types (which must be entirely consumed by the conversion), 
+/// `bool` ("true" or "false"), single characters and `std::string` (which 
+/// receives the value unchanged, including any whitespace). Other types may be 
+/// given faster or different conversions by specializing this template:
+/// \code
+/// template<>
+/// struct OptionValueConverter<MyType>{
+///     static bool convert(const char* begin, const char* end, MyType& value);
+/// };
+/// \endcode
+/// `convert` should return false if the text is not a valid value, and should
+/// preferably leave `value` unmodified in that case, as the provided 
+/// specializations do. 
+template<typename T, typename Enable=void>
+struct OptionValueConverter{
+	static bool convert(const char* begin, const char* end, T& value){
+		std::istringstream ss(std::string(begin,end));
+		ss.setf(std::cout.boolalpha);
+		ss >> value;
+		return(!ss.fail());
+	}
+};
+
+///Converts option values to std::string by copying them
+template<>
+struct OptionValueConverter<std::string>{
+	static bool convert(const char* begin, const char* end, std::string& value){
+		value.assign(begin,end);
+		return(true);
+	}
+};
+
+///Converts option values to bool, accepting "true" or "false"
+template<>
+struct OptionValueConverter<bool>{
+	static bool convert(const char* begin, const char* end, bool& value){
+		size_t len=end-begin;
+		if(len==4 && std::char_traits<char>::compare(begin,"true",4)==0)
+			value=true;
+		else if(len==5 && std::char_traits<char>::compare(begin,"false",5)==0)
+			value=false;
+		else
+			return(false);
+		return(true);
+	}
+};
+
+///Converts option values to narrow character types, requiring exactly one
+///character
+template<typename T>
+struct OptionValueConverter<T,typename std::enable_if<std::is_same<T,char>::value 
+                                                      || std::is_same<T,signed char>::value 
+                                                      || std::is_same<T,unsigned char>::value>::type>{
+	static bool convert(const char* begin, const char* end, T& value){
+		if(end-begin!=1)
+			return(false);
+		value=(T)*begin;
+		return(true);
+	}
+};
+
+///Converts option values to integer types. A leading '+' is permitted; a 
+///leading '-' only for signed types. 
+template<typename T>
+struct OptionValueConverter<T,typename std::enable_if<std::is_integral<T>::value 
+                                                      && !std::is_same<T,bool>::value
+                                                      && !std::is_same<T,char>::value
+                                                      && !std::is_same<T,signed char>::value
+                                                      && !std::is_same<T,unsigned char>::value
+                                                      && !std::is_same<T,wchar_t>::value
+                                                      && !std::is_same<T,char16_t>::value
+                                                      && !std::is_same<T,char32_t>::value>::type>{
+	static bool convert(const char* begin, const char* end, T& value){
+		if(begin!=end && *begin=='+' && (end-begin==1 || begin[1]!='-'))
+			begin++;
+#ifdef CL_OPTIONS_USE_FROM_CHARS
+		auto result=std::from_chars(begin,end,value);
+		return(result.ec==std::errc() && result.ptr==end);
+#else
+		using Unsigned=typename std::make_unsigned<T>::type;
+		bool negative=false;
+		if(begin!=end && *begin=='-'){
+			if(!std::is_signed<T>::value)
+				return(false);
+			negative=true;
+			begin++;
+		}
+		if(begin==end)
+			return(false);
+		const Unsigned limit=(Unsigned)std::numeric_limits<T>::max()+(negative?1:0);
+		Unsigned result=0;
+		for(; begin!=end; begin++){
+			unsigned int digit=(unsigned char)*begin-(unsigned char)'0';
+			if(digit>9 || result>(limit-digit)/10)
+				return(false);
+			result=10*result+digit;
+		}
+		value=(negative ? -(T)(result-1)-1 : (T)result);
+		return(true);
+#endif
+	}
+};
+
+///Converts option values to floating point types, which must consist only of 
+///a decimal number (or infinity or NaN), without leading whitespace. The 
+///decimal point is always '.', whatever the current locale. 
+template<typename T>
+struct OptionValueConverter<T,typename std::enable_if<std::is_floating_point<T>::value>::type>{
+	static bool convert(const char* begin, const char* end, T& value){
+		if(begin!=end && *begin=='+' && (end-begin==1 || begin[1]!='-'))
+			begin++;
+#ifdef CL_OPTIONS_USE_FROM_CHARS
+		auto result=std::from_chars(begin,end,value);
+		return(result.ec==std::errc() && result.ptr==end);
+#else
+		//accept exactly what from_chars does, which excludes the hexadecimal 
+		//forms strtod would also accept
+		if(!isNumber(begin,end))
+			return(false);
+		//strtod and friends require null termination
+		const size_t len=end-begin;
+		char buffer[64];
+		std::string longBuffer;
+		const char* text=buffer;
+		if(len<sizeof(buffer)){
+			std::char_traits<char>::copy(buffer,begin,len);
+			buffer[len]='\0';
+		}
+		else{
+			longBuffer.assign(begin,end);
+			text=longBuffer.c_str();
+		}
+		char* parsedEnd;
+		errno=0;
+		T result=parse(text,&parsedEnd,(T*)nullptr);
+		if(parsedEnd!=text+len){
+			//strtod uses the decimal point of the C locale, so where that is
+			//not '.' the number must be read independently of it
+			std::istringstream ss(text);
+			ss.imbue(std::locale::classic());
+			if(!(ss >> result) || ss.peek()!=std::char_traits<char>::eof())
+				return(false);
+		}
+		else if(errno==ERANGE && std::isinf(result))
+			return(false);
+		value=result;
+		return(true);
+#endif
+	}
+#ifndef CL_OPTIONS_USE_FROM_CHARS
+private:
+	///Whether text has the form accepted by from_chars: an optional '-', then
+	///either decimal digits with an optional point and exponent, or 'inf', 
+	///'infinity', or 'nan' (optionally followed by characters in 
+	///parentheses), regardless of case
+	static bool isNumber(const char* begin, const char* end){
+		if(begin!=end && *begin=='-')
+			begin++;
+		auto isDigit=[](char c){ return(c>='0' && c<='9'); };
+		auto matchWord=[&](const char* word)->bool{
+			const char* pos=begin;
+			for(; *word; word++, pos++){
+				if(pos==end || (*pos|0x20)!=*word)
+					return(false);
+			}
+			begin=pos;
+			return(true);
+		};
+		if(matchWord("inf")){
+			return(begin==end || (matchWord("inity") && begin==end));
+		}
+		if(matchWord("nan")){
+			if(begin==end)
+				return(true);
+			if(*begin++!='(')
+				return(false);
+			for(; begin!=end && *begin!=')'; begin++){
+				char lower=*begin|0x20;
+				if(!isDigit(*begin) && !(lower>='a' && lower<='z') && *begin!='_')
+					return(false);
+			}
+			return(begin!=end && begin+1==end);
+		}
+		bool anyDigits=false;
+		for(; begin!=end && isDigit(*begin); begin++)
+			anyDigits=true;
+		if(begin!=end && *begin=='.'){
+			for(begin++; begin!=end && isDigit(*begin); begin++)
+				anyDigits=true;
+		}
+		if(!anyDigits)
+			return(false);
+		if(begin!=end && (*begin=='e' || *begin=='E')){
+			begin++;
+			if(begin!=end && (*begin=='+' || *begin=='-'))
+				begin++;
+			if(begin==end || !isDigit(*begin))
+				return(false);
+			while(begin!=end && isDigit(*begin))
+				begin++;
+		}
+		return(begin==end);
+	}
+	static float parse(const char* text, char** end, float*){ return(std::strtof(text,end)); }
+	static double parse(const char* text, char** end, double*){ return(std::strtod(text,end)); }
+	static long double parse(const char* text, char** end, long double*){ return(std::strtold(text,end)); }
+#endif
+};
+
 ///A simple utility for parsing command line options. 
 ///
 /// Assuming an object of this class:
@@ -117,27 +383,536 @@
 ///  -x: Extract to disk from the archive.
 ///  -f: Read the archive from or write the archive to the specified file.
 /// \endverbatim
-/// The generation of this help message is currently very simple, and makes no 
-/// effort to reflow text, so users are advised to format description strings 
-/// themselves. 
+/// When printed by the built-in help options, descriptions are wrapped to the 
+/// width of the terminal.
 class OptionParser{
+public:
+	///A non-owning reference to a sequence of characters, used to examine 
+	///arguments without copying them. When compiled as C++17 or newer it 
+	///converts implicitly to std::string_view. 
+	class StringView{
+	public:
+		static constexpr size_t npos=std::string::npos;
+		
+		constexpr StringView():ptr(nullptr),len(0){}
+		constexpr StringView(const char* s, size_t n):ptr(s),len(n){}
+		StringView(const char* s):ptr(s),len(std::char_traits<char>::length(s)){}
+		template<typename Allocator>
+		StringView(const std::basic_string<char,std::char_traits<char>,Allocator>& s):
+		ptr(s.data()),len(s.size()){}
+		
+		constexpr const char* data() const{ return(ptr); }
+		constexpr size_t size() const{ return(len); }
+		constexpr bool empty() const{ return(len==0); }
+		constexpr const char* begin() const{ return(ptr); }
+		constexpr const char* end() const{ return(ptr+len); }
+		constexpr char operator[](size_t i) const{ return(ptr[i]); }
+		
+		///\pre pos<=size()
+		StringView substr(size_t pos, size_t n=npos) const{
+			return(StringView(ptr+pos,std::min(n,len-pos)));
+		}
+		size_t find(char c, size_t pos=0) const{
+			for(; pos<len; pos++){
+				if(ptr[pos]==c)
+					return(pos);
+			}
+			return(npos);
+		}
+		size_t find_first_not_of(char c, size_t pos=0) const{
+			for(; pos<len; pos++){
+				if(ptr[pos]!=c)
+					return(pos);
+			}
+			return(npos);
+		}
+		///Copy the referenced characters into a string
+		std::string str() const{ return(std::string(ptr,len)); }
+#if __cplusplus>=201703L
+		operator std::string_view() const{ return(std::string_view(ptr,len)); }
+#endif
+		
+		bool operator==(StringView other) const{
+			return(len==other.len && std::char_traits<char>::compare(ptr,other.ptr,len)==0);
+		}
+		bool operator!=(StringView other) const{ return(!(*this==other)); }
+	private:
+		const char* ptr;
+		size_t len;
+	};
+	
+	///The string type used for positional arguments when parsing with an
+	///allocator (of any value type) of type Allocator
+	template<typename Allocator>
+	using BasicString=std::basic_string<char,std::char_traits<char>,
+	  typename std::allocator_traits<Allocator>::template rebind_alloc<char>>;
+	
+	///The type of the list of positional arguments returned when parsing with an
+	///allocator of type Allocator
+	template<typename Allocator>
+	using PositionalList=std::vector<BasicString<Allocator>,
+	  typename std::allocator_traits<Allocator>::template rebind_alloc<BasicString<Allocator>>>;
+	
+	///Positional arguments returned as views rather than as strings. Arguments
+	///which were passed in directly are referenced where they are, so they 
+	///remain valid only as long as the original arguments; arguments read from 
+	///streams or files are packed into storage owned by this object.
+	class PositionalViews{
+	public:
+		using const_iterator=std::vector<StringView>::const_iterator;
+		
+		PositionalViews():next(nullptr),available(0),blockSize(256){}
+		PositionalViews(PositionalViews&&)=default;
+		PositionalViews& operator=(PositionalViews&&)=default;
+		
+		size_t size() const{ return(views.size()); }
+		bool empty() const{ return(views.empty()); }
+		StringView operator[](size_t i) const{ return(views[i]); }
+		const_iterator begin() const{ return(views.begin()); }
+		const_iterator end() const{ return(views.end()); }
+	private:
+		friend class OptionParser;
+		
+		///Append a view of an argument which will outlive this object
+		void reference(StringView arg){ views.push_back(arg); }
+		
+		///Append a copy of an argument which will not remain valid
+		void store(StringView arg){
+			if(arg.size()>available){
+				if(blockSize<(1u<<20))
+					blockSize*=2;
+				available=std::max(arg.size(),blockSize);
+				blocks.emplace_back(new char[available]);
+				next=blocks.back().get();
+			}
+			std::copy(arg.begin(),arg.end(),next);
+			views.push_back(StringView(next,arg.size()));
+			next+=arg.size();
+			available-=arg.size();
+		}
+		
+		std::vector<StringView> views;
+		///storage for copied arguments, which is never reallocated
+		std::vector<std::unique_ptr<char[]>> blocks;
+		char* next;
+		size_t available;
+		size_t blockSize;
+	};
+	
+	///Counts and timings collected during parses, to show where the time 
+	///spent parsing goes. Collection is enabled by passing an object of this
+	///type to collectStatistics, after which every parse adds to it.
+	struct ParseStatistics{
+		///What happened to one option
+		struct Option{
+			///the first name of the option
+			std::string name;
+			///the number of times the option's handler was invoked
+			uint64_t uses;
+			///the time spent in the option's callback
+			double callbackSeconds;
+			///the time spent converting the option's values
+			double conversionSeconds;
+		};
+		
+		ParseStatistics():parses(0),shortLookups(0),longLookups(0),environmentLookups(0),
+		filesOpened(0),bytesTokenized(0),maxIncludeDepth(0),totalSeconds(0),callbackSeconds(0),
+		conversionSeconds(0){}
+		
+		///the number of parses which have been measured
+		uint64_t parses;
+		///the number of lookups in the table of short options
+		uint64_t shortLookups;
+		///the number of lookups in the table of long options
+		uint64_t longLookups;
+		///the number of lookups in the table of environment variable names
+		uint64_t environmentLookups;
+		///the number of configuration and response files opened
+		uint64_t filesOpened;
+		///the number of bytes of files which were tokenized
+		uint64_t bytesTokenized;
+		///the greatest number of files being read at once
+		uint64_t maxIncludeDepth;
+		///the total time spent parsing, including in handlers
+		double totalSeconds;
+		///the time spent in the callbacks of all options
+		double callbackSeconds;
+		///the time spent converting the values of all options
+		double conversionSeconds;
+		///the statistics for each option, in the order the options were added
+		std::vector<Option> options;
+		
+		///Write a human-readable summary
+		void write(std::ostream& os) const{
+			os << "Option parsing statistics (" << parses << (parses==1?" parse":" parses") << "):\n"
+			   << "  time: " << totalSeconds << " s total, " << callbackSeconds << " s in callbacks, "
+			   << conversionSeconds << " s converting values, "
+			   << std::max(totalSeconds-callbackSeconds-conversionSeconds,0.) << " s in the parser\n"
+			   << "  lookups: " << shortLookups << " short, " << longLookups << " long, " 
+			   << environmentLookups << " environment\n"
+			   << "  files: " << filesOpened << " opened, " << bytesTokenized << " bytes tokenized, " 
+			   << "maximum include depth " << maxIncludeDepth << '\n';
+			for(const Option& option : options){
+				if(option.uses)
+					os << "  " << option.name << ": " << option.uses << (option.uses==1?" use, ":" uses, ")
+					   << option.callbackSeconds << " s in callbacks, " << option.conversionSeconds 
+					   << " s converting values\n";
+			}
+		}
+	};
+	
 private:
-	///short options which take a value
-	std::map<char,std::function<void(std::string)>> shortOptions;
-	///short options which do not take a value
-	std::map<char,std::function<void()>> shortOptionsNoStore;
-	///short options which correspond to reading a config file (an must take the file path as a value)
-	std::set<char> shortOptionsConfig;
-	///long options which take a value
-	std::map<std::string,std::function<void(std::string)>> longOptions;
-	///long options which do not take a value
-	std::map<std::string,std::function<void()>> longOptionsNoStore;
-	///long options which correspond to reading a config file (an must take the file path as a value)
-	std::set<std::string> longOptionsConfig;
+	///The ways in which a registered option can be handled
+	enum class OptionKind : unsigned char{
+		///an option which does not take a value
+		Flag,
+		///an option which takes a value
+		Value,
+		///an option which corresponds to reading a config file (and must take
+		///the file path as a value)
+		Config,
+		///an automatically added option which prints the help text
+		Help
+	};
+
+	///A type-erased handler for an option, which receives the target object of
+	///the parse (null unless one was given) and the option's value (empty for 
+	///flags), and returns false if the value could not be converted.
+	///Callables no larger than a std::function are stored inline rather than on
+	///the heap, and destinations are referred to by pointer, so registering an
+	///option requires no allocation of its own.
+	class OptionHandler{
+	public:
+		OptionHandler():invoker(nullptr),manager(nullptr){}
+		OptionHandler(const OptionHandler& other):invoker(other.invoker),manager(other.manager){
+			if(manager)
+				manager(Copy,storage,const_cast<Storage*>(&other.storage));
+			else
+				storage=other.storage;
+		}
+		OptionHandler(OptionHandler&& other) noexcept:invoker(other.invoker),manager(other.manager){
+			if(manager)
+				manager(Move,storage,&other.storage);
+			else
+				storage=other.storage;
+		}
+		OptionHandler& operator=(OptionHandler other) noexcept{
+			reset();
+			invoker=other.invoker;
+			manager=other.manager;
+			if(manager)
+				manager(Move,storage,&other.storage);
+			else
+				storage=other.storage;
+			return(*this);
+		}
+		~OptionHandler(){ reset(); }
+		
+		///Create a handler which owns a copy of a callable object, which must
+		///be invocable as bool(void*, StringView) const
+		template<typename F>
+		static OptionHandler make(F f){
+			OptionHandler h;
+			h.emplace(std::move(f),std::integral_constant<bool,StoredInline<F>::value>());
+			return(h);
+		}
+		
+		///\param callbackSeconds if not null, the time spent in any user callback
+		///                       is added to this
+		bool operator()(void* target, StringView value, double* callbackSeconds=nullptr) const{
+			return(invoker(storage,target,value,callbackSeconds));
+		}
+	private:
+		struct Storage{
+			alignas(std::function<void()>) unsigned char bytes[sizeof(std::function<void()>)];
+		};
+		enum Operation{Copy,Move,Destroy};
+		
+		template<typename F>
+		struct StoredInline : public std::integral_constant<bool,
+			sizeof(F)<=sizeof(Storage) && alignof(Storage)%alignof(F)==0
+			&& std::is_nothrow_move_constructible<F>::value>{};
+		
+		template<typename F>
+		void emplace(F&& f, std::true_type /*inline*/){
+			using Stored=typename std::decay<F>::type;
+			new (storage.bytes) Stored(std::forward<F>(f));
+			invoker=&invokeInline<Stored>;
+			if(!std::is_trivially_copyable<Stored>::value)
+				manager=&manageInline<Stored>;
+		}
+		template<typename F>
+		void emplace(F&& f, std::false_type /*inline*/){
+			using Stored=typename std::decay<F>::type;
+			new (storage.bytes) Stored*(new Stored(std::forward<F>(f)));
+			invoker=&invokeHeap<Stored>;
+			manager=&manageHeap<Stored>;
+		}
+		void reset(){
+			if(manager)
+				manager(Destroy,storage,nullptr);
+			invoker=nullptr;
+			manager=nullptr;
+		}
+		
+		///Whether a callable measures the time spent in user callbacks, by 
+		///accepting a third argument in which to record it
+		template<typename F>
+		struct TimesCallbacks{
+			template<typename G>
+			static auto test(int)->decltype(std::declval<const G&>()(nullptr,StringView(),(double*)nullptr),std::true_type());
+			template<typename G>
+			static std::false_type test(...);
+			static constexpr bool value=decltype(test<F>(0))::value;
+		};
+		template<typename F>
+		static bool call(const F& f, void* target, StringView value, double* callbackSeconds, std::true_type){
+			return(f(target,value,callbackSeconds));
+		}
+		template<typename F>
+		static bool call(const F& f, void* target, StringView value, double*, std::false_type){
+			return(f(target,value));
+		}
+		template<typename F>
+		static bool invokeInline(const Storage& s, void* target, StringView value, double* callbackSeconds){
+			return(call(*reinterpret_cast<const F*>(s.bytes),target,value,callbackSeconds,
+			            std::integral_constant<bool,TimesCallbacks<F>::value>()));
+		}
+		template<typename F>
+		static bool invokeHeap(const Storage& s, void* target, StringView value, double* callbackSeconds){
+			return(call(**reinterpret_cast<F* const*>(s.bytes),target,value,callbackSeconds,
+			            std::integral_constant<bool,TimesCallbacks<F>::value>()));
+		}
+		template<typename F>
+		static void manageInline(Operation op, Storage& dest, Storage* src){
+			switch(op){
+				case Copy:
+					new (dest.bytes) F(*reinterpret_cast<const F*>(src->bytes));
+					break;
+				case Move:
+					new (dest.bytes) F(std::move(*reinterpret_cast<F*>(src->bytes)));
+					break;
+				case Destroy:
+					reinterpret_cast<F*>(dest.bytes)->~F();
+					break;
+			}
+		}
+		template<typename F>
+		static void manageHeap(Operation op, Storage& dest, Storage* src){
+			switch(op){
+				case Copy:
+					new (dest.bytes) F*(new F(**reinterpret_cast<F* const*>(src->bytes)));
+					break;
+				case Move:
+					new (dest.bytes) F*(*reinterpret_cast<F**>(src->bytes));
+					*reinterpret_cast<F**>(src->bytes)=nullptr;
+					break;
+				case Destroy:
+					delete *reinterpret_cast<F**>(dest.bytes);
+					break;
+			}
+		}
+		
+		Storage storage;
+		bool (*invoker)(const Storage&, void*, StringView, double*);
+		void (*manager)(Operation, Storage&, Storage*);
+	};
+	
+	///The handler which converts a value into a destination variable
+	template<typename T>
+	struct StoreToDestination{
+		T* destination;
+		bool operator()(void*, StringView value) const{
+			return(OptionValueConverter<T>::convert(value.begin(),value.end(),*destination));
+		}
+	};
+	///Run a user callback, adding the time it takes to a total if one is given
+	template<typename Function>
+	static void timeCallback(double* seconds, const Function& f){
+		if(!seconds){
+			f();
+			return;
+		}
+		auto start=std::chrono::steady_clock::now();
+		f();
+		*seconds+=secondsSince(start);
+	}
+	static double secondsSince(std::chrono::steady_clock::time_point start){
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+	}
+	///The handler which invokes a callback taking no value
+	struct InvokeAction{
+		std::function<void()> action;
+		bool operator()(void*, StringView, double* callbackSeconds) const{
+			timeCallback(callbackSeconds,action);
+			return(true);
+		}
+	};
+	///The handler which converts a value and passes it to a callback
+	template<typename T>
+	struct InvokeCallback{
+		std::function<void(T)> action;
+		bool operator()(void*, StringView value, double* callbackSeconds) const{
+			T converted;
+			if(!OptionValueConverter<T>::convert(value.begin(),value.end(),converted))
+				return(false);
+			timeCallback(callbackSeconds,[&]{ action(std::move(converted)); });
+			return(true);
+		}
+	};
+	///The handler which converts a value into a member of the target object
+	template<typename Target, typename T>
+	struct StoreToMember{
+		T Target::* member;
+		bool operator()(void* target, StringView value) const{
+			return(OptionValueConverter<T>::convert(value.begin(),value.end(),
+			                                        static_cast<Target*>(target)->*member));
+		}
+	};
+	///The handler which invokes a callback taking only the target object
+	template<typename Target>
+	struct InvokeTargetAction{
+		std::function<void(Target&)> action;
+		bool operator()(void* target, StringView, double* callbackSeconds) const{
+			timeCallback(callbackSeconds,[&]{ action(*static_cast<Target*>(target)); });
+			return(true);
+		}
+	};
+	
+	///Check whether a value can be converted to a type, without storing it
+	template<typename T>
+	static bool canConvert(StringView value){
+		T converted;
+		return(OptionValueConverter<T>::convert(value.begin(),value.end(),converted));
+	}
+	///The function which checks values for an option of a given type, or null
+	///if checking would require a temporary the type cannot provide
+	template<typename T>
+	static bool (*validatorFor(std::true_type /*default constructible*/))(StringView){
+		return(&canConvert<T>);
+	}
+	template<typename T>
+	static bool (*validatorFor(std::false_type /*default constructible*/))(StringView){
+		return(nullptr);
+	}
+	
+	///The handler for a registered option, shared by all of its names
+	struct OptionEntry{
+		OptionKind kind;
+		///the callback for a Flag or Value option
+		OptionHandler handler;
+		///if not null, checks whether a value is acceptable to a Value option 
+		///without invoking its handler
+		bool (*validate)(StringView);
+		///the index of the option (shared by all of its synonyms) within 
+		///usageEntries
+		uint32_t option;
+	};
+
+	///An option name as recorded during registration
+	struct OptionName{
+		std::string name;
+		bool isShort;
+		uint32_t entry;
+	};
+
+	///An entry in the frozen lookup table
+	struct LookupRecord{
+		///the position of the option name within frozenNames
+		uint32_t nameOffset;
+		///the length of the option name
+		uint32_t nameLength;
+		bool isShort;
+		OptionKind kind;
+		///the index of the option's handler within options
+		uint32_t entry;
+	};
+
+	///the handlers for all registered options
+	std::vector<OptionEntry> options;
+	///all registered option names, kept sorted by nameOrder for duplicate
+	///detection
+	std::vector<OptionName> optionNames;
+	///the lookup table for long options compiled by freeze, sorted by nameOrder
+	std::vector<LookupRecord> lookupTable;
+	///the lookup table for short options compiled by freeze, indexed directly
+	///by the option character; unused slots have zero nameLength
+	std::array<LookupRecord,256> shortTable;
+	///the concatenation of all option names referenced by the lookup tables
+	std::string frozenNames;
+	///the type of the target object required by options which act on one, or
+	///null if there are no such options
+	const std::type_info* targetType;
+	///An entry in the table mapping environment variable names to long options
+	struct EnvironmentRecord{
+		///the position of the variable name (without any prefix) within 
+		///environmentNames
+		uint32_t nameOffset;
+		///the length of the variable name
+		uint32_t nameLength;
+		///the index of the option within lookupTable, or ambiguousEnvironmentName
+		///if several options correspond to this variable name
+		uint32_t record;
+	};
+	static constexpr uint32_t ambiguousEnvironmentName=std::numeric_limits<uint32_t>::max();
+	///the environment variable names corresponding to all long options, 
+	///compiled by freeze and sorted by name
+	std::vector<EnvironmentRecord> environmentTable;
+	///the concatenation of all names referenced by environmentTable
+	std::string environmentNames;
+	///whether the lookup tables are up to date with optionNames
+	bool frozen;
 	///whether the help message was automatically printed
 	bool printedUsage;
-	///the help text
+	///The default value of an option, kept so that it can be formatted only 
+	///if the help text is rendered
+	struct DefaultValue{
+		virtual ~DefaultValue(){}
+		virtual void write(const OptionParser& op, std::ostream& os) const=0;
+	};
+	///A copy of the value of a destination when its option was added
+	template<typename T>
+	struct StoredDefault : public DefaultValue{
+		T value;
+		explicit StoredDefault(const T& v):value(v){}
+		void write(const OptionParser& op, std::ostream& os) const override{
+			os << op.valueForDisplay(value);
+		}
+	};
+	///The text of a default value which could not be copied, so was formatted
+	///when its option was added
+	struct RenderedDefault : public DefaultValue{
+		std::string text;
+		explicit RenderedDefault(std::string t):text(std::move(t)){}
+		void write(const OptionParser&, std::ostream& os) const override{
+			os << text;
+		}
+	};
+	///The information needed to describe one option (with all of its synonyms)
+	///in the help text
+	struct UsageEntry{
+		///all of the option's names, separated by '=' (which names may not 
+		///contain), so that most options need no allocation for them
+		std::string names;
+		std::string description;
+		bool takesValue;
+		std::string valueName;
+		///null if the option has no default value to show
+		std::shared_ptr<const DefaultValue> defaultValue;
+		
+		///The first name of the option
+		std::string firstName() const{ return(names.substr(0,names.find('='))); }
+	};
+	///the text set by setBaseUsage, followed by a newline if set
+	std::string baseUsage;
+	///the help information for all registered options, in registration order
+	std::vector<UsageEntry> usageEntries;
+	///the help text rendered by getUsage
 	std::string usageMessage;
+	///the width to which usageMessage was wrapped
+	size_t usageWidth;
+	///whether usageMessage reflects the current options and settings
+	bool usageRendered;
 	///Whether a short option taking a value may be directly followed by its 
 	///value without a separating equals sign
 	bool allowShortValueWithoutEquals;
@@ -147,6 +922,22 @@ private:
 	bool allowShortOptionCombination;
 	///Whether the special option '--' ends option parsing
 	bool allowOptionTerminator;
+	///Whether arguments of the form '@file' are replaced by the contents of 
+	///the file
+	bool allowResponseFiles;
+	///Whether the hidden option '--cl-stats' prints statistics about the parse
+	bool allowStatisticsOption;
+	///Where statistics are collected, if anywhere
+	ParseStatistics* statistics;
+	///The longest argument accepted, in characters
+	size_t tokenLengthLimit;
+	///The greatest number of configuration and response files which may be 
+	///read inside one another
+	size_t includeDepthLimit;
+	///The greatest number of arguments accepted by one parse
+	size_t argumentLimit;
+	///The suffix which files in a configuration directory must have to be read
+	std::string configSuffix;
 	
 	///check whether an identifier is a valid option name
 	void checkIdentifier(std::string ident){
@@ -159,60 +950,301 @@ private:
 		//valid identifier, do nothing
 	}
 	
-	///check whether a short option already exists
-	bool optionKnown(char ident){
-		return(shortOptions.count(ident) || shortOptionsNoStore.count(ident) || shortOptionsConfig.count(ident));
+	///The order in which option names are sorted: all short options before
+	///all long options, and lexicographically within each group
+	///\return a negative number, zero, or a positive number if the first name
+	///        is ordered before, the same as, or after the second
+	static int nameOrder(bool aShort, const char* a, size_t aLen, bool bShort, const char* b, size_t bLen){
+		if(aShort!=bShort)
+			return(aShort?-1:1);
+		int result=std::char_traits<char>::compare(a,b,std::min(aLen,bLen));
+		if(result)
+			return(result);
+		return(aLen<bLen?-1:(aLen>bLen?1:0));
+	}
+
+	///Find the position of a name in optionNames
+	///\return the position at which the name is or should be inserted
+	std::vector<OptionName>::iterator findName(const std::string& ident, bool isShort){
+		return(std::lower_bound(optionNames.begin(),optionNames.end(),ident,
+		  [isShort](const OptionName& n, const std::string& ident){
+		  	return(nameOrder(n.isShort,n.name.data(),n.name.size(),isShort,ident.data(),ident.size())<0);
+		  }));
 	}
-	///check whether a long option already exists
-	bool optionKnown(std::string ident){
-		return(longOptions.count(ident) || longOptionsNoStore.count(ident) || longOptionsConfig.count(ident));
+
+	///\throws std::logic_error if the name is already in use
+	void checkUnused(const std::string& ident, bool isShort){
+		auto it=findName(ident,isShort);
+		if(it!=optionNames.end() && it->isShort==isShort && it->name==ident)
+			throw std::logic_error("Attempt to redefine option '"+ident+"'");
 	}
-	
-	///ensure that a value is a string
-	static std::string asString(std::string s){ return s; }
-	///ensure that a value is a string
-	static std::string asString(char c){ return std::string(1,c); }
-	
+	///Record a name for the option whose handler will next be stored by 
+	///storeEntry
+	void addName(const std::string& ident, bool isShort){
+		optionNames.insert(findName(ident,isShort),OptionName{ident,isShort,(uint32_t)options.size()});
+	}
+	///Store the handler shared by all of the names of an option
+	void storeEntry(OptionEntry entry){
+		//the usage entry for the option is added after all of its names
+		entry.option=(uint32_t)usageEntries.size();
+		options.push_back(std::move(entry));
+		frozen=false;
+	}
+	///Register a new option name with its handler
+	///\throws std::logic_error if the name is already in use
+	void addEntry(const std::string& ident, bool isShort, OptionEntry entry){
+		checkUnused(ident,isShort);
+		addName(ident,isShort);
+		storeEntry(std::move(entry));
+	}
+	///Register a new option name with its handler
+	void addEntry(char ident, OptionEntry entry){
+		addEntry(std::string(1,ident),true,std::move(entry));
+	}
+	///Register a new option name with its handler
+	void addEntry(const std::string& ident, OptionEntry entry){
+		addEntry(ident,false,std::move(entry));
+	}
+	///Register all of the synonyms of an option with a single handler, those 
+	///of one character as short options
+	///\throws std::logic_error if any name is already in use, in which case 
+	///       none are registered
+	void addEntry(std::initializer_list<std::string> idents, OptionEntry entry){
+		for(auto ident=idents.begin(); ident!=idents.end(); ++ident){
+			checkUnused(*ident,ident->size()==1);
+			if(std::find(idents.begin(),ident,*ident)!=ident)
+				throw std::logic_error("Attempt to redefine option '"+*ident+"'");
+		}
+		for(const std::string& ident : idents)
+			addName(ident,ident.size()==1);
+		storeEntry(std::move(entry));
+	}
+
 	///Add an option which stores a value to a variable
 	template<typename IDType, typename DestType>
-	void addOption(IDType ident, DestType& destination, std::map<IDType,std::function<void(std::string)>>& storeMap){
-		if(optionKnown(ident))
-			throw std::logic_error("Attempt to redefine option '"+asString(ident)+"'");
-		storeMap.emplace(ident,
-		                 [ident,&destination](std::string optData)->void{
-		                 	std::istringstream ss(optData);
-		                 	ss.setf(std::cout.boolalpha);	
-		                 	ss >> destination;
-		                 	if(ss.fail()){
-		                 		throw std::runtime_error("Failed to parse \""+optData+"\" as argument to '"
-		                 		                         +asString(ident)+"' option");
-		                 	}
-		                 });
+	void addValueOption(IDType ident, DestType& destination){
+		addEntry(ident,OptionEntry{OptionKind::Value,
+		  OptionHandler::make(StoreToDestination<DestType>{&destination}),
+		  validatorFor<DestType>(std::is_default_constructible<DestType>()),0});
 	}
 	///Add an option with a callback which takes nothing
 	template<typename IDType>
-	void addOption(IDType ident, std::function<void()> action, std::map<IDType,std::function<void()>>& storeMap){
-		if(optionKnown(ident))
-			throw std::logic_error("Attempt to redefine option '"+asString(ident)+"'");
-		storeMap.emplace(ident,action);
+	void addFlagOption(IDType ident, std::function<void()> action){
+		addEntry(ident,OptionEntry{OptionKind::Flag,
+		  OptionHandler::make(InvokeAction{std::move(action)}),nullptr,0});
 	}
 	///Add an option with a callback which takes a value
 	template<typename DestType, typename IDType>
-	void addOption(IDType ident, std::function<void(DestType)> action, std::map<IDType,std::function<void(std::string)>>& storeMap){
-		if(optionKnown(ident))
-			throw std::logic_error("Attempt to redefine option '"+asString(ident)+"'");
-		storeMap.emplace(ident,std::function<void(std::string)>(
-						 [ident,action](std::string optData)->void{
-							 std::istringstream ss(optData);
-							 DestType destination;
-							 ss.setf(std::cout.boolalpha);	
-							 ss >> destination;
-							 if(ss.fail()){
-								 throw std::runtime_error("Failed to parse \""+optData+"\" as argument to '"
-														  +asString(ident)+"' option");
-							 }
-							 action(destination);
-						 }));
+	void addCallbackOption(IDType ident, std::function<void(DestType)> action){
+		addEntry(ident,OptionEntry{OptionKind::Value,
+		  OptionHandler::make(InvokeCallback<DestType>{std::move(action)}),&canConvert<DestType>,0});
+	}
+	///Add an option which reads further configuration from a file
+	template<typename IDType>
+	void addConfigOption(IDType ident){
+		addEntry(ident,OptionEntry{OptionKind::Config,OptionHandler(),nullptr,0});
+	}
+	///Add an option whose handler acts on the target object of each parse
+	///\throws std::logic_error if options acting on a different type of 
+	///       target have already been added
+	template<typename Target>
+	void addTargetOption(std::initializer_list<std::string> idents, OptionKind kind, OptionHandler handler){
+		if(targetType && *targetType!=typeid(Target))
+			throw std::logic_error("All options which act on a target object must use the same type of target");
+		for(const auto& ident : idents)
+			checkIdentifier(ident);
+		addEntry(idents,OptionEntry{kind,std::move(handler),nullptr,0});
+		targetType=&typeid(Target);
+	}
+	///Add the automatic help options
+	void addHelpOption(std::initializer_list<std::string> idents, std::string description){
+		addEntry(idents,OptionEntry{OptionKind::Help,OptionHandler(),nullptr,0});
+		addUsage(joinNames(idents),std::move(description),false,std::string());
+	}
+	
+	///Prepare to parse without a target object
+	///\throws std::logic_error if any options require a target object
+	void prepareParse(){
+		if(!frozen)
+			freeze();
+		if(targetType)
+			throw std::logic_error("Options which act on a target object require a target to be passed to parseArgs");
+	}
+	///Start collecting statistics for a parse, if they are wanted
+	template<typename State>
+	void beginParse(State& ps) const{
+		if(statistics)
+			startStatistics(ps,statistics);
+	}
+	///Begin adding statistics about the rest of a parse to an object
+	template<typename State>
+	void startStatistics(State& ps, ParseStatistics* stats) const{
+		ps.statistics=stats;
+		for(size_t i=stats->options.size(); i<usageEntries.size(); i++)
+			stats->options.push_back(ParseStatistics::Option{usageEntries[i].firstName(),0,0,0});
+		ps.startTime=std::chrono::steady_clock::now();
+	}
+	///Handle the '--cl-stats' option, which causes statistics to be collected
+	///(from this point) and reported at the end of the parse
+	template<typename State>
+	void startStatisticsReport(State& ps) const{
+		if(!ps.statistics){
+			ps.ownStatistics.reset(new ParseStatistics());
+			startStatistics(ps,ps.ownStatistics.get());
+		}
+		ps.reportStatistics=true;
+	}
+	///Record the outcome of a parse without a target object
+	template<typename State>
+	void concludeParse(const State& ps){
+		if(ps.printedUsage)
+			printedUsage=true;
+	}
+	///Invoke an option's handler, timing it if statistics are being collected
+	template<typename State>
+	bool invokeHandler(State& ps, const LookupRecord& option, StringView value) const{
+		const OptionEntry& entry=options[option.entry];
+		if(!ps.statistics)
+			return(entry.handler(ps.target,value));
+		double callbackSeconds=0;
+		auto start=std::chrono::steady_clock::now();
+		bool result=entry.handler(ps.target,value,&callbackSeconds);
+		//whatever time was not spent in a callback was spent converting
+		double conversionSeconds=std::max(secondsSince(start)-callbackSeconds,0.);
+		ParseStatistics::Option& stats=ps.statistics->options[entry.option];
+		stats.uses++;
+		stats.callbackSeconds+=callbackSeconds;
+		stats.conversionSeconds+=conversionSeconds;
+		ps.statistics->callbackSeconds+=callbackSeconds;
+		ps.statistics->conversionSeconds+=conversionSeconds;
+		return(result);
+	}
+	///Print the help text for an automatic help option. The text is rendered
+	///anew, so that concurrent parses need not share a cache.
+	template<typename State>
+	void showHelp(State& ps) const{
+		if(ps.showUsage){
+			std::string text=renderUsage(terminalWidth());
+			text+='\n';
+			std::cout.write(text.data(),text.size()).flush();
+		}
+		ps.printedUsage=true;
+	}
+	///Check that a parse with a target object may proceed
+	///\throws std::logic_error if the parser is not frozen or the target is
+	///       not of the type used when adding options
+	template<typename Target>
+	void checkTarget() const{
+		if(!frozen)
+			throw std::logic_error("The parser must be frozen before parsing with a target");
+		if(targetType && *targetType!=typeid(Target))
+			throw std::logic_error("The target passed to parseArgs is not of the type used by the options");
+	}
+	///Parse one record of a batch which is a command line, split with the 
+	///same rules as configuration files
+	template<typename State, typename Record>
+	void parseRecord(State& ps, const Record& record, std::true_type /*command line*/) const{
+		StringView line(record);
+		using TokenIterator=TokenIterator<const char*,std::string>;
+		parseTokens(ps,TokenIterator(line.begin(),line.end(),std::allocator<char>(),tokenLengthLimit),
+		            TokenIterator(line.end(),line.end()));
+	}
+	///Parse one record of a batch which is a collection of arguments
+	template<typename State, typename Record>
+	void parseRecord(State& ps, const Record& record, std::false_type /*command line*/) const{
+		using std::begin;
+		using std::end;
+		parseTokens(ps,begin(record),end(record));
+	}
+	
+	///Pass a value to the handler of a Value option
+	///\throws std::runtime_error if the value cannot be converted
+	template<typename State>
+	void storeValue(State& ps, const LookupRecord& option, StringView value) const{
+		if(ps.recording){
+			ps.recording->record(options[option.entry],option.entry,value);
+			if(!ps.recording->apply)
+				return;
+		}
+		if(!invokeHandler(ps,option,value)){
+			throw std::runtime_error("Failed to parse \""+value.str()+"\" as argument to '"
+			  +frozenNames.substr(option.nameOffset,option.nameLength)+"' option");
+		}
+	}
+	///Invoke the handler of a Flag or Help option
+	template<typename State>
+	void invokeFlag(State& ps, const LookupRecord& option) const{
+		if(ps.recording){
+			if(option.kind!=OptionKind::Help)
+				ps.recording->record(options[option.entry],option.entry,StringView());
+			if(!ps.recording->apply)
+				return;
+		}
+		if(option.kind==OptionKind::Help)
+			showHelp(ps);
+		else
+			invokeHandler(ps,option,StringView());
+	}
+
+	///Look up a long option in the frozen lookup table
+	///\pre freeze has been called since the last option was added
+	///\return the record for the option, or null if there is no such option
+	const LookupRecord* findOption(const char* name, size_t len) const{
+		auto it=std::lower_bound(lookupTable.begin(),lookupTable.end(),0,
+		  [&](const LookupRecord& r, int){
+		  	return(nameOrder(false,frozenNames.data()+r.nameOffset,r.nameLength,false,name,len)<0);
+		  });
+		if(it==lookupTable.end() || nameOrder(false,frozenNames.data()+it->nameOffset,it->nameLength,false,name,len)!=0)
+			return(nullptr);
+		return(&*it);
+	}
+	///Look up a short option in the frozen lookup table
+	///\pre freeze has been called since the last option was added
+	///\return the record for the option, or null if there is no such option
+	const LookupRecord* findOption(char ident) const{
+		const LookupRecord& record=shortTable[(unsigned char)ident];
+		return(record.nameLength?&record:nullptr);
+	}
+	///Look up a long option in the frozen lookup table
+	const LookupRecord* findOption(StringView ident) const{
+		return(findOption(ident.data(),ident.size()));
+	}
+	///Look up the option corresponding to an environment variable
+	///\param name the name of the variable with its prefix removed
+	///\pre freeze has been called since the last option was added
+	///\return the entry for the variable, or null if there is no such option
+	const EnvironmentRecord* findEnvironmentOption(StringView name) const{
+		auto it=std::lower_bound(environmentTable.begin(),environmentTable.end(),0,
+		  [&](const EnvironmentRecord& r, int){
+		  	return(nameOrder(false,environmentNames.data()+r.nameOffset,r.nameLength,false,name.data(),name.size())<0);
+		  });
+		if(it==environmentTable.end() || nameOrder(false,environmentNames.data()+it->nameOffset,it->nameLength,false,name.data(),name.size())!=0)
+			return(nullptr);
+		return(&*it);
+	}
+	///Construct the environment variable name corresponding to a long option,
+	///by converting letters to upper case and dashes to underscores
+	static void appendEnvironmentName(std::string& out, const char* name, size_t len){
+		for(size_t i=0; i<len; i++){
+			char c=name[i];
+			if(c>='a' && c<='z')
+				c=c-'a'+'A';
+			else if(c=='-')
+				c='_';
+			out+=c;
+		}
+	}
+	///Interpret the value of an environment variable corresponding to a flag
+	///\param set whether the flag should be invoked
+	///\return whether the value was valid: empty, "1", "0", "true", or "false"
+	static bool environmentFlagValue(StringView value, bool& set){
+		if(value.empty() || value==StringView("1"))
+			set=true;
+		else if(value==StringView("0"))
+			set=false;
+		else
+			return(OptionValueConverter<bool>::convert(value.begin(),value.end(),set));
+		return(true);
 	}
 	
 	struct ArgumentState{
@@ -226,230 +1258,1217 @@ private:
 			///the special option  which ends option parsing
 			OptionTerminator
 		} type;
-		const std::string option;
-		ArgumentState(ArgumentStateType t):type(t){
+		///the option which requires a value
+		const LookupRecord* const option;
+		ArgumentState(ArgumentStateType t):type(t),option(nullptr){
 			if(type==OptionNeedsValue)
-				throw std::logic_error("OptionNeedsValue state must have an option name");
+				throw std::logic_error("OptionNeedsValue state must have an option");
 		}
-		ArgumentState(ArgumentStateType t, std::string opt):type(t),option(opt){}
+		ArgumentState(ArgumentStateType t, const LookupRecord* opt):type(t),option(opt){}
 	};
 	
-	struct ParsingState{
-		std::vector<std::string> positionals;
-		std::vector<std::string> fileStack;
+	///Identifies a file independently of the path used to reach it
+	struct FileIdentity{
+		uint64_t device;
+		uint64_t inode;
+		///the modification time, so that a file which is changed is treated as
+		///a different file
+		int64_t modificationSeconds;
+		int64_t modificationNanoseconds;
+		
+		bool operator==(const FileIdentity& other) const{
+			return(device==other.device && inode==other.inode 
+			  && modificationSeconds==other.modificationSeconds
+			  && modificationNanoseconds==other.modificationNanoseconds);
+		}
+	};
+	struct FileIdentityHash{
+		size_t operator()(const FileIdentity& id) const{
+			uint64_t h=id.inode*0x9E3779B97F4A7C15ull;
+			h^=id.device+0x632BE59BD9B4E019ull+(h<<6)+(h>>2);
+			h^=uint64_t(id.modificationNanoseconds)+(h<<6)+(h>>2);
+			return(size_t(h));
+		}
 	};
 	
-	///Process one argument as a short option
-	///\param arg the argument
-	///\param startIdx the character index within arg where the option should begin
-	ArgumentState handleShortOption(const std::string& arg, const size_t startIdx, ParsingState& ps){
-		static const auto& npos=std::string::npos;
-		size_t endIdx, valueOffset=0;
-		if(allowShortValueWithoutEquals || allowShortOptionCombination){
-			endIdx=startIdx+1;
-			if(endIdx==arg.size())
-				endIdx=npos;
-			else if(arg[endIdx]=='=')
-				valueOffset=1;
+	///The tokens of a configuration file, packed into one string
+	template<typename String>
+	struct CachedFile{
+		using Allocator=typename String::allocator_type;
+		using OffsetList=std::vector<size_t,typename std::allocator_traits<Allocator>::template rebind_alloc<size_t>>;
+		
+		explicit CachedFile(const Allocator& alloc):
+		path(alloc),fileSize(0),text(alloc),ends(typename OffsetList::allocator_type(alloc)){}
+		
+		size_t size() const{ return(ends.size()); }
+		StringView operator[](size_t i) const{
+			size_t begin=(i?ends[i-1]:0);
+			return(StringView(text.data()+begin,ends[i]-begin));
 		}
-		else{
-			endIdx=arg.find('=',startIdx);
-			valueOffset=1;
+		
+		///the path by which the file was first reached
+		String path;
+		uint64_t fileSize;
+		String text;
+		///the position in text after the end of each token
+		OffsetList ends;
+	};
+	
+	///An iterator over the tokens of a CachedFile
+	template<typename Cache>
+	struct CachedTokenIterator{
+		const Cache* cache;
+		size_t index;
+		
+		StringView operator*() const{ return((*cache)[index]); }
+		CachedTokenIterator& operator++(){
+			++index;
+			return(*this);
 		}
-		std::string opt=arg.substr(startIdx,(endIdx==npos?npos:endIdx-startIdx));
+		bool operator==(const CachedTokenIterator& other) const{ return(index==other.index); }
+		bool operator!=(const CachedTokenIterator& other) const{ return(index!=other.index); }
+	};
+	
+	///The effective values of the options used in a parse, along with the files
+	///which were read, so that a later parse of the same configuration can be
+	///compared against it
+	struct ParseRecording{
+		///All uses of an option (under any of its names)
+		struct Use{
+			///the option entry last used
+			uint32_t entry;
+			///the value given by each use, in order (empty for flags)
+			std::vector<std::string> values;
+			
+			bool used() const{ return(!values.empty()); }
+		};
 		
-		if(opt.empty())
-			throw std::runtime_error("Invalid option: '"+arg+"'");
-		
-		if(opt.size()>1)
-			throw std::runtime_error("Malformed option: '"+arg+"' (wrong number of leading dashes)");
-		
-		char optC=opt[0];
-		if(shortOptionsNoStore.count(optC)){
-			if(endIdx!=npos && !allowShortOptionCombination)
-				throw std::runtime_error("Malformed option: '"+arg+"' (no value expected for this flag)");
-			shortOptionsNoStore.find(optC)->second();
-			//if stuff remains in the argument, recurse to process it
-			if(allowShortOptionCombination && endIdx!=npos)
-				return(handleShortOption(arg,startIdx+1,ps)); 
-		}
-		else if(shortOptions.count(optC)){
-			if(endIdx==npos)
-				return(ArgumentState{ArgumentState::OptionNeedsValue,opt});
-			std::string value=arg.substr(endIdx+valueOffset);
-			shortOptions.find(optC)->second(value);
-		}
-		else if(shortOptionsConfig.count(optC)){
-			if(endIdx==npos)
-				return(ArgumentState{ArgumentState::OptionNeedsValue,opt});
-			std::string value=arg.substr(endIdx+valueOffset);
-			parseArgsFromFile(ps, value);
+		explicit ParseRecording(bool applyHandlers):apply(applyHandlers){}
+		
+		void record(const OptionEntry& option, uint32_t entry, StringView value){
+			if(uses.size()<=option.option)
+				uses.resize(option.option+1,Use{0,{}});
+			Use& use=uses[option.option];
+			use.entry=entry;
+			use.values.emplace_back(value.begin(),value.end());
 		}
-		else
-			throw std::runtime_error("Unknown option: '"+opt+"' in '"+arg+"'");
 		
-		return(ArgumentState::Option);
-	}
+		///whether option handlers should be invoked as well as recorded
+		bool apply;
+		///uses of options, indexed by OptionEntry::option
+		std::vector<Use> uses;
+		///the paths of all files which were read
+		std::vector<std::string> files;
+		///the paths of all configuration directories which were read
+		std::vector<std::string> directories;
+		///the identities of all files which were read
+		std::unordered_set<FileIdentity,FileIdentityHash> fileIdentities;
+	};
 	
-	///Process one argument as a long option
-	///\param arg the argument
-	///\param startIdx the character index within arg where the option should begin
-	ArgumentState handleLongOption(const std::string& arg, const size_t startIdx, ParsingState& ps){
-		static const auto& npos=std::string::npos;
-		size_t endIdx=arg.find('=',startIdx);
-		std::string opt=arg.substr(startIdx,(endIdx==npos?npos:endIdx-startIdx));
+	///All memory allocated while parsing (other than for error messages) comes 
+	///from the state's allocator
+	template<typename Allocator>
+	struct ParsingState{
+		using CharAllocator=typename std::allocator_traits<Allocator>::template rebind_alloc<char>;
+		using String=BasicString<Allocator>;
+		using StringList=PositionalList<Allocator>;
 		
-		if(opt.empty())
-			throw std::runtime_error("Invalid option: '"+arg+"'");
+		using Cache=CachedFile<String>;
+		template<typename T>
+		using Rebind=typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+		using IdentitySet=std::unordered_set<FileIdentity,FileIdentityHash,
+		  std::equal_to<FileIdentity>,Rebind<FileIdentity>>;
+		using CacheMap=std::unordered_map<FileIdentity,Cache,FileIdentityHash,
+		  std::equal_to<FileIdentity>,Rebind<std::pair<const FileIdentity,Cache>>>;
 		
-		if(opt.size()==1)
-			throw std::runtime_error("Malformed option: '"+arg+"' (wrong number of leading dashes)");
+		explicit ParsingState(const Allocator& alloc):allocator(alloc),
+		positionals(typename StringList::allocator_type(allocator)),
+		fileStack(typename StringList::allocator_type(allocator)),
+		activeFiles(0,FileIdentityHash(),std::equal_to<FileIdentity>(),
+		            typename IdentitySet::allocator_type(allocator)),
+		fileCache(0,FileIdentityHash(),std::equal_to<FileIdentity>(),
+		          typename CacheMap::allocator_type(allocator)),recording(nullptr),
+		target(nullptr),printedUsage(false),showUsage(true),statistics(nullptr),reportStatistics(false),
+		arguments(0){}
 		
-		std::string value;
-		if(endIdx!=npos && endIdx!=arg.size()-1)
-			value=arg.substr(endIdx+1);
+		ParsingState(const ParsingState&)=delete;
+		ParsingState& operator=(const ParsingState&)=delete;
+		///Statistics are concluded here, so that parses which fail are 
+		///counted, and reported if requested, as well
+		~ParsingState(){ concludeStatistics(); }
 		
-		if(longOptions.count(opt)){
-			if(endIdx==npos)
-				return(ArgumentState{ArgumentState::OptionNeedsValue,opt});
-			longOptions.find(opt)->second(value);
+		///Count the parse in its statistics, and write them if requested. 
+		///This happens only once, when the state is destroyed if not before.
+		void concludeStatistics(){
+			if(!statistics)
+				return;
+			statistics->parses++;
+			statistics->totalSeconds+=secondsSince(startTime);
+			if(reportStatistics)
+				statistics->write(std::cerr);
+			statistics=nullptr;
 		}
-		else if(longOptionsNoStore.count(opt)){
-			if(endIdx!=npos)
-				throw std::runtime_error("Malformed option: '"+arg+"' (no value expected for this flag)");
-			longOptionsNoStore.find(opt)->second();
+		
+		String makeString(StringView s) const{
+			return(String(s.begin(),s.end(),allocator));
 		}
-		else if(longOptionsConfig.count(opt)){
-			if(endIdx==npos)
-				return(ArgumentState{ArgumentState::OptionNeedsValue,opt});
-			parseArgsFromFile(ps, value);
+		
+		///\param stable whether arg will remain valid after the parse
+		void addPositional(StringView arg, bool /*stable*/){
+			positionals.push_back(makeString(arg));
 		}
-		else
-			throw std::runtime_error("Unknown option: '"+arg+"'");
 		
-		return(ArgumentState::Option);
-	}
+		CharAllocator allocator;
+		StringList positionals;
+		///the paths of the configuration files currently being read, for 
+		///error messages
+		StringList fileStack;
+		///the configuration files currently being read, for detecting cycles
+		IdentitySet activeFiles;
+		///the tokens of every configuration file read so far
+		CacheMap fileCache;
+		///if not null, where the options used and files read are recorded
+		ParseRecording* recording;
+		///the object on which options registered with a target act
+		void* target;
+		///whether the help message was printed (or requested, if showUsage 
+		///is false)
+		bool printedUsage;
+		///whether a request for the help message prints it, rather than only
+		///setting printedUsage
+		bool showUsage;
+		///if not null, where statistics about the parse are collected
+		ParseStatistics* statistics;
+		///statistics collected only for the '--cl-stats' option
+		std::unique_ptr<ParseStatistics> ownStatistics;
+		///when statistics collection began
+		std::chrono::steady_clock::time_point startTime;
+		///whether the '--cl-stats' option was used
+		bool reportStatistics;
+		///the number of arguments processed so far, including those read 
+		///from files
+		size_t arguments;
+	};
 	
-	///Process one argument in isolation
-	///\return the type of the argument and whether it was consumed
-	ArgumentState handleNextArg(const std::string& arg, ParsingState& ps){
-		if(arg.size()<2) //not an option, skip it
-			return(ArgumentState::NonOption);
-		if(arg[0]!='-') //not an option, skip it
-			return(ArgumentState::NonOption);
-		if(allowOptionTerminator && arg=="--")
-			return(ArgumentState::OptionTerminator);
-		size_t startIdx=arg.find_first_not_of('-');
-		if(startIdx>2) //not an option, skip it
-			return(ArgumentState::NonOption);
-		if(startIdx==1) //dealing with a short option
-			return(handleShortOption(arg,startIdx,ps));
-		else //dealing with a long option
+	///State for a parse which collects views of positional arguments
+	struct ViewParsingState : public ParsingState<std::allocator<char>>{
+		ViewParsingState():ParsingState<std::allocator<char>>(std::allocator<char>()){}
+		
+		void addPositional(StringView arg, bool stable){
+			if(stable)
+				views.reference(arg);
+			else
+				views.store(arg);
+		}
+		
+		PositionalViews views;
+	};
+	
+	///Process one argument as a short option
+	///\param arg the argument
+	///\param startIdx the character index within arg where the option should begin
+	template<typename State>
+	ArgumentState handleShortOption(StringView arg, size_t startIdx, State& ps) const{
+		static const auto& npos=std::string::npos;
+		//each option in a combined group is handled by one pass of this loop
+		while(true){
+			size_t endIdx, valueOffset=0;
+			if(allowShortValueWithoutEquals || allowShortOptionCombination){
+				endIdx=startIdx+1;
+				if(endIdx==arg.size())
+					endIdx=npos;
+				else if(arg[endIdx]=='=')
+					valueOffset=1;
+			}
+			else{
+				endIdx=arg.find('=',startIdx);
+				valueOffset=1;
+			}
+			StringView opt=arg.substr(startIdx,(endIdx==npos?npos:endIdx-startIdx));
+			
+			if(opt.empty())
+				throw std::runtime_error("Invalid option: '"+arg.str()+"'");
+			
+			if(opt.size()>1)
+				throw std::runtime_error("Malformed option: '"+arg.str()+"' (wrong number of leading dashes)");
+			
+			const LookupRecord* record=findOption(opt[0]);
+			if(ps.statistics)
+				ps.statistics->shortLookups++;
+			if(!record)
+				throw std::runtime_error("Unknown option: '"+opt.str()+"' in '"+arg.str()+"'");
+			switch(record->kind){
+				case OptionKind::Flag:
+				case OptionKind::Help:
+					if(endIdx!=npos && !allowShortOptionCombination)
+						throw std::runtime_error("Malformed option: '"+arg.str()+"' (no value expected for this flag)");
+					invokeFlag(ps,*record);
+					//if stuff remains in the argument, go on to process it
+					if(allowShortOptionCombination && endIdx!=npos){
+						startIdx++;
+						continue;
+					}
+					break;
+				case OptionKind::Value:
+					if(endIdx==npos)
+						return(ArgumentState{ArgumentState::OptionNeedsValue,record});
+					storeValue(ps,*record,arg.substr(endIdx+valueOffset));
+					break;
+				case OptionKind::Config:
+					if(endIdx==npos)
+						return(ArgumentState{ArgumentState::OptionNeedsValue,record});
+					parseArgsFromFile(ps, arg.substr(endIdx+valueOffset));
+					break;
+			}
+			
+			return(ArgumentState::Option);
+		}
+	}
+	
+	///Process one argument as a long option
+	///\param arg the argument
+	///\param startIdx the character index within arg where the option should begin
+	template<typename State>
+	ArgumentState handleLongOption(StringView arg, const size_t startIdx, State& ps) const{
+		static const auto& npos=std::string::npos;
+		size_t endIdx=arg.find('=',startIdx);
+		StringView opt=arg.substr(startIdx,(endIdx==npos?npos:endIdx-startIdx));
+		
+		if(opt.empty())
+			throw std::runtime_error("Invalid option: '"+arg.str()+"'");
+		
+		if(opt.size()==1)
+			throw std::runtime_error("Malformed option: '"+arg.str()+"' (wrong number of leading dashes)");
+		
+		StringView value;
+		if(endIdx!=npos)
+			value=arg.substr(endIdx+1);
+		
+		const LookupRecord* record=findOption(opt);
+		if(ps.statistics)
+			ps.statistics->longLookups++;
+		if(!record){
+			if(allowStatisticsOption && endIdx==npos && opt==StringView("cl-stats")){
+				startStatisticsReport(ps);
+				return(ArgumentState::Option);
+			}
+			throw std::runtime_error("Unknown option: '"+arg.str()+"'");
+		}
+		switch(record->kind){
+			case OptionKind::Value:
+				if(endIdx==npos)
+					return(ArgumentState{ArgumentState::OptionNeedsValue,record});
+				storeValue(ps,*record,value);
+				break;
+			case OptionKind::Flag:
+			case OptionKind::Help:
+				if(endIdx!=npos)
+					throw std::runtime_error("Malformed option: '"+arg.str()+"' (no value expected for this flag)");
+				invokeFlag(ps,*record);
+				break;
+			case OptionKind::Config:
+				if(endIdx==npos)
+					return(ArgumentState{ArgumentState::OptionNeedsValue,record});
+				parseArgsFromFile(ps, value);
+				break;
+		}
+		
+		return(ArgumentState::Option);
+	}
+	
+	///Process one argument in isolation
+	///\return the type of the argument and whether it was consumed
+	template<typename State>
+	ArgumentState handleNextArg(StringView arg, State& ps) const{
+		if(arg.size()<2) //not an option, skip it
+			return(ArgumentState::NonOption);
+		if(arg[0]!='-') //not an option, skip it
+			return(ArgumentState::NonOption);
+		if(allowOptionTerminator && arg.size()==2 && arg[1]=='-')
+			return(ArgumentState::OptionTerminator);
+		size_t startIdx=arg.find_first_not_of('-');
+		if(startIdx>2) //not an option, skip it
+			return(ArgumentState::NonOption);
+		if(startIdx==1) //dealing with a short option
+			return(handleShortOption(arg,startIdx,ps));
+		else //dealing with a long option
 			return(handleLongOption(arg,startIdx,ps));
 	}
 	
 	///Process an argument which takes a value
-	///\param option the name of the value consuming option previously encountered
+	///\param option the value consuming option previously encountered
 	///\param value the next argument, taken to be the value
 	///\pre the argument has aready been classified and sanity checked by handleNextArg
-	void handleOptWithValue(const std::string& opt, const std::string& value, ParsingState& ps){
-		if(opt.size()==1){
-			char optC=opt[0];
-			if(shortOptions.count(optC))
-				shortOptions.find(optC)->second(value);
-			else if(shortOptionsConfig.count(optC))
-				parseArgsFromFile(ps, value);
-			else
-				throw std::runtime_error("Internal logic error handling option: '"+opt+"'");
-		}
-		else{
-			if(longOptions.count(opt))
-				longOptions.find(opt)->second(value);
-			else if(longOptionsConfig.count(opt))
+	template<typename State>
+	void handleOptWithValue(const LookupRecord& option, StringView value, State& ps) const{
+		switch(option.kind){
+			case OptionKind::Value:
+				storeValue(ps,option,value);
+				break;
+			case OptionKind::Config:
 				parseArgsFromFile(ps, value);
-			else
-				throw std::runtime_error("Internal logic error handling option: '"+opt+"'");
+				break;
+			default:
+				throw std::runtime_error("Internal logic error handling option: '"
+				  +frozenNames.substr(option.nameOffset,option.nameLength)+"'");
 		}
 	}
 	
-	template<typename Iterator>
-	std::vector<std::string> parseArgs(ParsingState& ps, Iterator argBegin, Iterator argEnd){
+	///Check an argument against the limits on argument length and count
+	///\throws std::runtime_error if either limit is exceeded
+	template<typename State>
+	void countArgument(State& ps, StringView arg) const{
+		if(arg.size()>tokenLengthLimit)
+			throw std::runtime_error("Argument longer than the limit of "
+			  +std::to_string(tokenLengthLimit)+" characters: '"+arg.substr(0,32).str()+"...'");
+		if(++ps.arguments>argumentLimit)
+			throw tooManyArguments();
+	}
+	
+	std::runtime_error tooManyArguments() const{
+		return(std::runtime_error("Too many arguments (the limit is "
+		  +std::to_string(argumentLimit)+")"));
+	}
+	
+	template<typename State, typename Iterator>
+	void parseTokens(State& ps, Iterator argBegin, Iterator argEnd) const{
+		const bool stable=TokensAreStable<Iterator>::value;
 		while(argBegin!=argEnd){
-			std::string arg=*argBegin;
+			//binding the token keeps it alive for this iteration even if the 
+			//iterator returns it by value; for TokenIterators it also remains
+			//valid across one increment
+			auto&& token=*argBegin;
+			StringView arg=token;
+			countArgument(ps,arg);
 			ArgumentState state=handleNextArg(arg,ps);
 			switch(state.type){
 				case ArgumentState::Option:
 					//nothing left to do
 					break;
 				case ArgumentState::NonOption:
-					//treat as a positional argument
-					ps.positionals.push_back(arg);
+					if(allowResponseFiles && arg.size()>1 && arg[0]=='@')
+						parseResponseFile(ps,arg.substr(1));
+					else //treat as a positional argument
+						ps.addPositional(arg,stable);
 					break;
 				case ArgumentState::OptionNeedsValue:
-					argBegin++;
+					++argBegin;
 					if(argBegin==argEnd)
-						throw std::runtime_error("Missing value for '"+arg+"'");
-					handleOptWithValue(state.option,*argBegin,ps);
+						throw std::runtime_error("Missing value for '"+arg.str()+"'");
+					{
+						auto&& value=*argBegin;
+						countArgument(ps,value);
+						handleOptWithValue(*state.option,value,ps);
+					}
 					break;
 				case ArgumentState::OptionTerminator:
 					//no more option parsing should be done; shove all remaining
 					//arguments into positionals
-					for(argBegin++; argBegin!=argEnd; argBegin++)
-						ps.positionals.push_back(*argBegin);
+					for(++argBegin; argBegin!=argEnd; ++argBegin){
+						auto&& positional=*argBegin;
+						countArgument(ps,positional);
+						ps.addPositional(positional,stable);
+					}
 					break;
 			}
 			
 			//move to the next argument, unless we know all arguments have 
 			//already been consumed
 			if(state.type!=ArgumentState::OptionTerminator)
-				argBegin++;
+				++argBegin;
+		}
+	}
+	
+	///Apply all environment variables which begin with a prefix followed by
+	///the environment name of a long option. Other variables are ignored.
+	///\param environment a null-terminated array of "NAME=value" strings
+	template<typename State>
+	void parseEnvironment(State& ps, StringView prefix, const char* const* environment) const{
+		for(; environment && *environment; ++environment){
+			const char* variable=*environment;
+			if(std::strncmp(variable,prefix.data(),prefix.size())!=0)
+				continue;
+			const char* name=variable+prefix.size();
+			const char* equals=std::strchr(name,'=');
+			if(!equals)
+				continue;
+			const EnvironmentRecord* entry=findEnvironmentOption(StringView(name,equals-name));
+			if(ps.statistics)
+				ps.statistics->environmentLookups++;
+			if(!entry)
+				continue;
+			if(entry->record==ambiguousEnvironmentName)
+				throw std::runtime_error("Environment variable "+std::string(variable,equals)
+				  +" corresponds to more than one option");
+			const LookupRecord& record=lookupTable[entry->record];
+			StringView value(equals+1);
+			//each variable applied counts as one argument
+			countArgument(ps,value);
+			switch(record.kind){
+				case OptionKind::Value:
+					storeValue(ps,record,value);
+					break;
+				case OptionKind::Flag:
+				case OptionKind::Help:
+				{
+					bool set=false;
+					if(!environmentFlagValue(value,set))
+						throw std::runtime_error("Failed to parse \""+value.str()+"\" as the value of environment variable "
+						  +std::string(variable,equals)+" (expected 1, 0, true, or false)");
+					if(set)
+						invokeFlag(ps,record);
+					break;
+				}
+				case OptionKind::Config:
+					parseArgsFromFile(ps,value);
+					break;
+			}
+		}
+	}
+	
+	///The environment of the current process, as a null-terminated array of
+	///"NAME=value" strings
+	static const char* const* processEnvironment(){
+#if defined(__APPLE__)
+		return(*_NSGetEnviron());
+#elif defined(CL_OPTIONS_POSIX)
+		return(environ);
+#elif defined(_WIN32)
+		return(_environ);
+#else
+		return(nullptr);
+#endif
+	}
+	
+	template<typename State>
+	void parseArgsFromFile(State& ps, StringView path) const{
+		typename State::String pathString=ps.makeString(path);
+		FileContents contents;
+		if(!contents.open(pathString.c_str()))
+			throw std::runtime_error("Unable to read "+path.str());
+		if(contents.isDirectory()){
+			contents.release();
+			parseArgsFromDirectory(ps,pathString);
+			return;
+		}
+		const FileIdentity identity=contents.identity();
+		enterFile(ps,identity,std::move(pathString));
+		//tokenize each file only once per parse, no matter how often it is 
+		//included
+		auto cached=ps.fileCache.find(identity);
+		if(cached==ps.fileCache.end()){
+			if(!contents.read())
+				throw std::runtime_error("Unable to read "+path.str());
+			if(ps.statistics)
+				ps.statistics->bytesTokenized+=contents.end()-contents.begin();
+			typename State::Cache tokens(ps.allocator);
+			tokens.path=ps.fileStack.back();
+			tokens.fileSize=contents.fileSize();
+			tokenize(contents.begin(),contents.end(),tokens.text,tokens.ends,ps.arguments);
+			cached=ps.fileCache.emplace(identity,std::move(tokens)).first;
 		}
-		return(ps.positionals);
+		//do not hold the file open while any files it includes are read
+		contents.release();
+		replayFile(ps,identity,cached->second);
 	}
 	
-	std::vector<std::string> parseArgsFromFile(ParsingState& ps, std::string path){
-		if(std::find(ps.fileStack.begin(),ps.fileStack.end(),path)!=ps.fileStack.end()){
+	///Record that a file is being read
+	///\throws std::runtime_error if the file is already being read, or if 
+	///        too many files are already being read
+	template<typename State>
+	void enterFile(State& ps, const FileIdentity& identity, typename State::String path) const{
+		if(ps.fileStack.size()>=includeDepthLimit){
+			std::ostringstream err;
+			err << "Configuration files nested more than " << includeDepthLimit 
+			    << " deep, reading " << path << "\nConfiguration parsing terminated";
+			throw std::runtime_error(err.str());
+		}
+		if(!ps.activeFiles.insert(identity).second){
 			std::ostringstream err;
 			err << "Configuration file loop: ";
-			for(const auto file : ps.fileStack)
+			for(const auto& file : ps.fileStack)
 				err << "\n  " << file;
 			err << "\n  " << path << "\nConfiguration parsing terminated";
 			throw std::runtime_error(err.str());
 		}
-		std::ifstream infile(path);
-		if(!infile)
-			throw std::runtime_error("Unable to read "+path);
-		using CharIterator=std::istreambuf_iterator<char>;
-		using TokenIterator=TokenIterator<CharIterator>;
-		CharIterator cit(infile), cend;
-		TokenIterator it(cit,cend), end(cend,cend);
-		ps.fileStack.push_back(path);
-		parseArgs(ps,it,end);
+		ps.fileStack.push_back(std::move(path));
+		if(ps.statistics){
+			ps.statistics->filesOpened++;
+			ps.statistics->maxIncludeDepth=std::max<uint64_t>(ps.statistics->maxIncludeDepth,ps.fileStack.size());
+		}
+	}
+	
+	///Expand a response file in place. Unlike configuration files, response 
+	///files are not cached: their tokens are streamed directly from the 
+	///file's contents into the parse, since they are expected to be large and
+	///read only once.
+	template<typename State>
+	void parseResponseFile(State& ps, StringView path) const{
+		typename State::String pathString=ps.makeString(path);
+		FileContents contents;
+		if(!contents.open(pathString.c_str()) || contents.isDirectory() || !contents.read())
+			throw std::runtime_error("Unable to read response file "+path.str());
+		const FileIdentity identity=contents.identity();
+		enterFile(ps,identity,std::move(pathString));
+		if(ps.statistics)
+			ps.statistics->bytesTokenized+=contents.end()-contents.begin();
+		if(ps.recording){
+			const auto& recordedPath=ps.fileStack.back();
+			ps.recording->files.emplace_back(recordedPath.begin(),recordedPath.end());
+			ps.recording->fileIdentities.insert(identity);
+		}
+		using TokenIterator=TokenIterator<const char*,typename State::String>;
+		parseTokens(ps,TokenIterator(contents.begin(),contents.end(),ps.allocator,tokenLengthLimit),
+		          TokenIterator(contents.end(),contents.end(),ps.allocator));
+		ps.fileStack.pop_back();
+		ps.activeFiles.erase(identity);
+	}
+	
+	///Parse the cached tokens of a file entered with enterFile
+	template<typename State>
+	void replayFile(State& ps, const FileIdentity& identity, const typename State::Cache& tokens) const{
+		if(ps.recording){
+			const auto& path=ps.fileStack.back();
+			ps.recording->files.emplace_back(path.begin(),path.end());
+			ps.recording->fileIdentities.insert(identity);
+		}
+		using CachedIterator=CachedTokenIterator<typename State::Cache>;
+		parseTokens(ps,CachedIterator{&tokens,0},CachedIterator{&tokens,tokens.size()});
 		ps.fileStack.pop_back();
-		return(ps.positionals);
+		ps.activeFiles.erase(identity);
+	}
+	
+	///Split the contents of a file into tokens, packed into a single string,
+	///enforcing the limits on argument length and count as the file is read
+	///\param arguments the number of arguments already processed by the 
+	///                 parse for which the file is read
+	template<typename String, typename OffsetList>
+	void tokenize(const char* begin, const char* end, String& text, OffsetList& ends, size_t arguments) const{
+		using TokenIterator=TokenIterator<const char*,String>;
+		//the tokens can be no longer than the text from which they come, but 
+		//when the length is limited, the file may be rejected after reading
+		//only a little of it
+		if(tokenLengthLimit==std::numeric_limits<size_t>::max())
+			text.reserve(text.size()+(end-begin));
+		for(TokenIterator it(begin,end,text.get_allocator(),tokenLengthLimit), 
+		    stop(end,end,text.get_allocator()); it!=stop; ++it){
+			if(++arguments>argumentLimit)
+				throw tooManyArguments();
+			text.append(*it);
+			ends.push_back(text.size());
+		}
+	}
+	
+	///Run a function for each index in [0,count), spreading the calls over 
+	///as many threads as the hardware supports. Each thread repeatedly claims
+	///the next block of indices, so threads which finish quickly take on more.
+	///\param work the function to run, which must not throw
+	///\param grain the number of consecutive indices claimed at once
+	template<typename Function>
+	static void runConcurrently(size_t count, Function work, size_t grain=1){
+		size_t blocks=(count+grain-1)/grain;
+		size_t threadCount=std::min<size_t>(std::max(1u,std::thread::hardware_concurrency()),blocks);
+		std::atomic<size_t> next(0);
+		auto worker=[&]{
+			for(size_t block; (block=next++)<blocks; ){
+				for(size_t i=block*grain, end=std::min(i+grain,count); i<end; i++)
+					work(i);
+			}
+		};
+		std::vector<std::thread> threads;
+		try{
+			for(size_t i=1; i<threadCount; i++)
+				threads.emplace_back(worker);
+		}catch(std::system_error&){
+			//continue with however many threads could be started
+		}
+		worker();
+		for(std::thread& thread : threads)
+			thread.join();
+	}
+	
+	///List the files in a configuration directory which should be read
+	///\return the file names, in sorted order
+	std::vector<std::string> listConfigDirectory(const char* path) const{
+		std::vector<std::string> names;
+#ifdef CL_OPTIONS_POSIX
+		DIR* dir=opendir(path);
+		if(!dir)
+			throw std::runtime_error("Unable to read "+std::string(path));
+		while(const dirent* entry=readdir(dir)){
+			StringView name(entry->d_name);
+			//skip hidden files, as well as '.' and '..'
+			if(name.empty() || name[0]=='.')
+				continue;
+			if(name.size()<configSuffix.size() 
+			   || name.substr(name.size()-configSuffix.size())!=configSuffix)
+				continue;
+			names.push_back(name.str());
+		}
+		closedir(dir);
+#endif
+		std::sort(names.begin(),names.end());
+		return(names);
+	}
+	
+	///Parse all matching files in a directory, in sorted order. The files are
+	///read and tokenized concurrently, and then parsed one at a time.
+	template<typename State>
+	void parseArgsFromDirectory(State& ps, const typename State::String& directory) const{
+		std::vector<std::string> names=listConfigDirectory(directory.c_str());
+		if(ps.recording)
+			ps.recording->directories.emplace_back(directory.begin(),directory.end());
+		enum LoadStatus{Failed,Skipped,Cached,Loaded};
+		struct LoadedFile{
+			std::string path;
+			LoadStatus status;
+			FileIdentity identity;
+			uint64_t fileSize;
+			std::string text;
+			std::vector<size_t> ends;
+			///the message of the exception which stopped the file from being
+			///loaded, if any
+			std::string error;
+		};
+		std::vector<LoadedFile> files(names.size());
+		std::string prefix(directory.begin(),directory.end());
+		if(!prefix.empty() && prefix.back()!='/')
+			prefix+='/';
+		for(size_t i=0; i<names.size(); i++){
+			files[i].path=prefix+names[i];
+			files[i].status=Failed;
+		}
+		//the shared state is only read while the files are being loaded
+		const auto& fileCache=ps.fileCache;
+		const size_t arguments=ps.arguments;
+		runConcurrently(files.size(),[&](size_t i){
+			LoadedFile& file=files[i];
+			try{
+				FileContents contents;
+				if(!contents.open(file.path.c_str()))
+					return;
+				if(!contents.isRegularFile()){
+					file.status=Skipped;
+					return;
+				}
+				file.identity=contents.identity();
+				file.fileSize=contents.fileSize();
+				if(fileCache.count(file.identity)){
+					file.status=Cached;
+					return;
+				}
+				if(!contents.read())
+					return;
+				tokenize(contents.begin(),contents.end(),file.text,file.ends,arguments);
+				file.status=Loaded;
+			}catch(std::exception& ex){
+				file.status=Failed;
+				file.error=ex.what();
+			}catch(...){
+				file.status=Failed;
+				file.error="Unknown exception";
+			}
+		});
+		for(LoadedFile& file : files){
+			if(file.status==Failed){
+				if(!file.error.empty())
+					throw std::runtime_error("Error reading "+file.path+": "+file.error);
+				throw std::runtime_error("Unable to read "+file.path);
+			}
+			if(file.status==Skipped)
+				continue;
+			if(ps.statistics && file.status==Loaded)
+				ps.statistics->bytesTokenized+=file.fileSize;
+			auto cached=ps.fileCache.find(file.identity);
+			if(cached==ps.fileCache.end()){
+				typename State::Cache tokens(ps.allocator);
+				tokens.path=ps.makeString(file.path);
+				tokens.fileSize=file.fileSize;
+				tokens.text.assign(file.text.begin(),file.text.end());
+				tokens.ends.assign(file.ends.begin(),file.ends.end());
+				cached=ps.fileCache.emplace(file.identity,std::move(tokens)).first;
+			}
+			//release the memory of the temporary copy promptly
+			std::string().swap(file.text);
+			std::vector<size_t>().swap(file.ends);
+			enterFile(ps,file.identity,ps.makeString(file.path));
+			replayFile(ps,file.identity,cached->second);
+		}
+	}
+	
+	///The contents of a file, mapped into memory where possible and otherwise
+	///read into a buffer, so that they can be tokenized as one contiguous block
+	class FileContents{
+	public:
+		FileContents():
+#ifdef CL_OPTIONS_POSIX
+		fd(-1),
+#endif
+		data(nullptr),size(0),mapped(false){}
+		FileContents(const FileContents&)=delete;
+		FileContents& operator=(const FileContents&)=delete;
+		~FileContents(){ release(); }
+		
+		///Open a file and determine its identity, without reading it
+		///\return whether the file could be opened
+		bool open(const char* path){
+			release();
+#ifdef CL_OPTIONS_POSIX
+			//not inherited by child processes, since other threads may start
+			//them while the file is open
+			fd=::open(path,O_RDONLY|O_CLOEXEC);
+			if(fd<0)
+				return(false);
+			if(fstat(fd,&info)!=0){
+				release();
+				return(false);
+			}
+			fileIdentity.device=info.st_dev;
+			fileIdentity.inode=info.st_ino;
+	#if defined(__APPLE__)
+			fileIdentity.modificationSeconds=info.st_mtimespec.tv_sec;
+			fileIdentity.modificationNanoseconds=info.st_mtimespec.tv_nsec;
+	#else
+			fileIdentity.modificationSeconds=info.st_mtim.tv_sec;
+			fileIdentity.modificationNanoseconds=info.st_mtim.tv_nsec;
+	#endif
+#else
+			stream.open(path,std::ios::binary);
+			if(!stream)
+				return(false);
+			//without a portable notion of file identity, fall back to the path
+			fileIdentity.device=0;
+			fileIdentity.inode=std::hash<std::string>()(path);
+			fileIdentity.modificationSeconds=0;
+			fileIdentity.modificationNanoseconds=0;
+#endif
+			return(true);
+		}
+		
+		///The identity of the opened file
+		const FileIdentity& identity() const{ return(fileIdentity); }
+		
+		///The size of the opened file, or zero if it cannot be determined 
+		///before reading
+		uint64_t fileSize() const{
+#ifdef CL_OPTIONS_POSIX
+			return(info.st_size);
+#else
+			return(size);
+#endif
+		}
+		
+		///Whether the opened file is a directory
+		bool isDirectory() const{
+#ifdef CL_OPTIONS_POSIX
+			return(S_ISDIR(info.st_mode));
+#else
+			return(false);
+#endif
+		}
+		///Whether the opened file is an ordinary file
+		bool isRegularFile() const{
+#ifdef CL_OPTIONS_POSIX
+			return(S_ISREG(info.st_mode));
+#else
+			return(true);
+#endif
+		}
+		
+		///Read the contents of the opened file
+		///\return whether the file could be read
+		bool read(){
+#ifdef CL_OPTIONS_POSIX
+			if(S_ISREG(info.st_mode) && info.st_size>0){
+				void* mapping=mmap(nullptr,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+				if(mapping!=MAP_FAILED){
+	#ifdef MADV_SEQUENTIAL
+					madvise(mapping,info.st_size,MADV_SEQUENTIAL);
+	#endif
+					data=static_cast<const char*>(mapping);
+					size=info.st_size;
+					mapped=true;
+					return(true);
+				}
+			}
+			//fall back to reading everything into the buffer, e.g. for pipes
+			const size_t chunkSize=1u<<16;
+			while(true){
+				size_t used=buffer.size();
+				buffer.resize(used+chunkSize);
+				ssize_t result=::read(fd,&buffer[used],chunkSize);
+				buffer.resize(used+(result>0?result:0));
+				if(result==0)
+					break;
+				if(result<0 && errno!=EINTR)
+					return(false);
+			}
+#else
+			buffer.assign(std::istreambuf_iterator<char>(stream),std::istreambuf_iterator<char>());
+			if(stream.bad())
+				return(false);
+#endif
+			data=buffer.data();
+			size=buffer.size();
+			return(true);
+		}
+		
+		///Open and read a file
+		///\return whether the file could be read
+		bool load(const char* path){
+			return(open(path) && read());
+		}
+		
+		///Close the file and discard its contents
+		void release(){
+#ifdef CL_OPTIONS_POSIX
+			if(mapped)
+				munmap(const_cast<char*>(data),size);
+			if(fd>=0)
+				::close(fd);
+			fd=-1;
+#else
+			if(stream.is_open())
+				stream.close();
+#endif
+			std::vector<char>().swap(buffer);
+			data=nullptr;
+			size=0;
+			mapped=false;
+		}
+		
+		const char* begin() const{ return(data); }
+		const char* end() const{ return(data+size); }
+	private:
+#ifdef CL_OPTIONS_POSIX
+		int fd;
+		struct stat info;
+#else
+		std::ifstream stream;
+#endif
+		FileIdentity fileIdentity;
+		const char* data;
+		size_t size;
+		///whether data refers to a mapping rather than to buffer
+		bool mapped;
+		std::vector<char> buffer;
+	};
+	
+	///Identifies the snapshot format, including the byte order and version
+	static const char* snapshotMagic(){ return("CLOPTSNP"); }
+	static const uint32_t snapshotVersion=1;
+	static const uint32_t snapshotByteOrder=0x01020304;
+	
+	///Append the bytes of a value to a snapshot being written
+	template<typename T>
+	static void appendSnapshotValue(std::string& out, T value){
+		out.append(reinterpret_cast<const char*>(&value),sizeof(T));
+	}
+	
+	///Bounds-checked reading from a snapshot
+	struct SnapshotReader{
+		const char* pos;
+		const char* end;
+		
+		template<typename T>
+		bool read(T& value){
+			if(size_t(end-pos)<sizeof(T))
+				return(false);
+			std::memcpy(&value,pos,sizeof(T));
+			pos+=sizeof(T);
+			return(true);
+		}
+		bool read(StringView& bytes, uint64_t length){
+			if(uint64_t(end-pos)<length)
+				return(false);
+			bytes=StringView(pos,length);
+			pos+=length;
+			return(true);
+		}
+	};
+	
+	///Load the cached tokens of the files recorded in a snapshot, if every 
+	///one of them is unchanged
+	///\return whether the snapshot was valid and loaded
+	template<typename State>
+	bool loadSnapshot(State& ps, StringView snapshotPath){
+#ifdef CL_OPTIONS_POSIX
+		FileContents snapshot;
+		if(!snapshot.load(snapshotPath.str().c_str()))
+			return(false);
+		SnapshotReader in{snapshot.begin(),snapshot.end()};
+		StringView magic;
+		uint32_t byteOrder, version, fileCount;
+		if(!in.read(magic,8) || magic!=snapshotMagic() || !in.read(byteOrder) 
+		   || byteOrder!=snapshotByteOrder || !in.read(version) || version!=snapshotVersion
+		   || !in.read(fileCount))
+			return(false);
+		for(uint32_t i=0; i<fileCount; i++){
+			uint32_t pathLength, tokenCount;
+			StringView path;
+			FileIdentity recorded;
+			uint64_t fileSize, textSize;
+			if(!in.read(pathLength) || !in.read(path,pathLength) || !in.read(recorded.device)
+			   || !in.read(recorded.inode) || !in.read(recorded.modificationSeconds)
+			   || !in.read(recorded.modificationNanoseconds) || !in.read(fileSize)
+			   || !in.read(textSize) || !in.read(tokenCount))
+				break;
+			//sizes which the rest of the snapshot cannot hold are corrupt, and 
+			//must not be used to reserve memory
+			if(textSize>uint64_t(in.end-in.pos) || uint64_t(tokenCount)*sizeof(uint32_t)>uint64_t(in.end-in.pos))
+				break;
+			//the dependency must still be the same file, unmodified
+			typename State::Cache tokens(ps.allocator);
+			tokens.path=ps.makeString(path);
+			FileContents current;
+			if(!current.open(tokens.path.c_str()) || !(current.identity()==recorded)
+			   || current.fileSize()!=fileSize)
+				break;
+			tokens.fileSize=fileSize;
+			tokens.text.reserve(textSize);
+			tokens.ends.reserve(tokenCount);
+			uint32_t j;
+			for(j=0; j<tokenCount; j++){
+				uint32_t length;
+				StringView token;
+				if(!in.read(length) || !in.read(token,length))
+					break;
+				tokens.text.append(token.begin(),token.end());
+				tokens.ends.push_back(tokens.text.size());
+			}
+			if(j!=tokenCount)
+				break;
+			ps.fileCache.emplace(recorded,std::move(tokens));
+		}
+		if(ps.fileCache.size()==fileCount && in.pos==in.end)
+			return(true);
+		ps.fileCache.clear();
+#endif
+		return(false);
+	}
+	
+	///Write the cached tokens of all files read during a parse to a snapshot.
+	///Failure to write the snapshot is not an error, since it only means that
+	///it will not be available in the future. 
+	template<typename State>
+	void writeSnapshot(const State& ps, StringView snapshotPath){
+#ifdef CL_OPTIONS_POSIX
+		std::string out(snapshotMagic());
+		appendSnapshotValue(out,snapshotByteOrder);
+		appendSnapshotValue(out,snapshotVersion);
+		appendSnapshotValue(out,uint32_t(ps.fileCache.size()));
+		for(const auto& file : ps.fileCache){
+			const FileIdentity& id=file.first;
+			const typename State::Cache& tokens=file.second;
+			appendSnapshotValue(out,uint32_t(tokens.path.size()));
+			out.append(tokens.path.data(),tokens.path.size());
+			appendSnapshotValue(out,id.device);
+			appendSnapshotValue(out,id.inode);
+			appendSnapshotValue(out,id.modificationSeconds);
+			appendSnapshotValue(out,id.modificationNanoseconds);
+			appendSnapshotValue(out,tokens.fileSize);
+			appendSnapshotValue(out,uint64_t(tokens.text.size()));
+			appendSnapshotValue(out,uint32_t(tokens.size()));
+			for(size_t i=0; i<tokens.size(); i++){
+				StringView token=tokens[i];
+				appendSnapshotValue(out,uint32_t(token.size()));
+				out.append(token.data(),token.size());
+			}
+		}
+		//write to a temporary file and rename it into place, so that other 
+		//processes never see a partial snapshot
+		std::string finalPath=snapshotPath.str();
+		std::string tempPath=finalPath+"."+std::to_string(getpid())+".tmp";
+		{
+			std::ofstream file(tempPath,std::ios::binary|std::ios::trunc);
+			if(!file)
+				return;
+			file.write(out.data(),out.size());
+			if(!file){
+				file.close();
+				std::remove(tempPath.c_str());
+				return;
+			}
+		}
+		if(std::rename(tempPath.c_str(),finalPath.c_str())!=0)
+			std::remove(tempPath.c_str());
+#endif
+	}
+	
+	///Invoke the handlers of options whose uses differ between two parses of 
+	///the same configuration. An option is applied if the sequence of values 
+	///given to it (or, for a flag, the number of times it was used) changed, 
+	///by replaying all of its uses in order. Options which are no longer used
+	///are left as they are. All new values are checked before any handler is
+	///invoked (except those of types which are not default constructible), so
+	///that a bad value prevents any change from being applied. 
+	///\param changed the first name of each option which was applied is 
+	///               appended to this
+	///\throws std::runtime_error if a new value cannot be converted
+	void applyChanges(const ParseRecording& previous, const ParseRecording& current, 
+	                  std::vector<std::string>& changed){
+		std::vector<size_t> toApply;
+		for(size_t i=0; i<current.uses.size(); i++){
+			const ParseRecording::Use& use=current.uses[i];
+			if(!use.used())
+				continue;
+			if(i<previous.uses.size() && previous.uses[i].values==use.values)
+				continue;
+			const OptionEntry& option=options[use.entry];
+			if(option.kind!=OptionKind::Flag && option.validate){
+				for(const std::string& value : use.values){
+					if(!option.validate(value))
+						throw conversionFailure(value,i);
+				}
+			}
+			toApply.push_back(i);
+		}
+		for(size_t i : toApply){
+			const ParseRecording::Use& use=current.uses[i];
+			const OptionEntry& option=options[use.entry];
+			for(const std::string& value : use.values){
+				if(option.kind==OptionKind::Flag)
+					option.handler(nullptr,StringView());
+				else if(!option.handler(nullptr,value))
+					throw conversionFailure(value,i);
+			}
+			changed.push_back(usageEntries[i].firstName());
+		}
+	}
+	///The error for a value which cannot be converted for an option
+	///\param option the index of the option within usageEntries
+	std::runtime_error conversionFailure(const std::string& value, size_t option) const{
+		return(std::runtime_error("Failed to parse \""+value+"\" as argument to '"
+		  +usageEntries[option].firstName()+"' option"));
 	}
 	
 	///Construct a string describing all of the synonyms for an option
-	static std::string synonymList(const std::initializer_list<std::string>& list){
+	///\param names the names, separated by '='
+	static std::string synonymList(const std::string& names){
+		std::string list;
+		for(size_t pos=0; pos<names.size(); ){
+			size_t end=std::min(names.find('=',pos),names.size());
+			if(pos!=0)
+				list+=", ";
+			list+=(end-pos==1 ? "-" : "--");
+			list.append(names,pos,end-pos);
+			pos=end+1;
+		}
+		return(list);
+	}
+	///Join the synonyms for an option into the form stored in UsageEntry
+	static std::string joinNames(std::initializer_list<std::string> idents){
+		std::string names;
+		for(const std::string& ident : idents){
+			if(!names.empty())
+				names+='=';
+			names+=ident;
+		}
+		return(names);
+	}
+	
+	///Record the help information for an option
+	///\param names the option's names, separated by '='
+	void addUsage(std::string names, std::string description, bool takesValue, std::string valueName){
+		usageEntries.push_back(UsageEntry{std::move(names),std::move(description),
+		  takesValue,std::move(valueName),nullptr});
+		usageRendered=false;
+	}
+	///Record the help information for an option which shows the current value
+	///of its destination as its default
+	///\param names the option's names, separated by '='
+	template<typename T>
+	void addValueUsage(std::string names, std::string description, std::string valueName, const T& destination){
+		addUsage(std::move(names),std::move(description),true,std::move(valueName));
+		//the destination can change without affecting the help text
+		usageEntries.back().defaultValue=makeDefault(destination,std::is_copy_constructible<T>());
+	}
+	///Copy a default value, to be formatted only when the help text is
+	///rendered
+	template<typename T>
+	static std::shared_ptr<const DefaultValue> makeDefault(const T& value, std::true_type /*copyable*/){
+		return(std::make_shared<StoredDefault<T>>(value));
+	}
+	///Format a default value which cannot be copied immediately
+	template<typename T>
+	std::shared_ptr<const DefaultValue> makeDefault(const T& value, std::false_type /*copyable*/) const{
 		std::ostringstream ss;
-		for(auto begin=list.begin(), it=begin, end=list.end(); it!=end; it++){
-			if(it!=begin)
-				ss << ", ";
-			if(it->size()==1)
-				ss << '-';
-			else
-				ss << "--";
-			ss << *it;
+		ss << valueForDisplay(value);
+		return(std::make_shared<RenderedDefault>(ss.str()));
+	}
+	
+	///Write a description following the header for its option (separated by a
+	///space), indenting lines after the first and, if width is nonzero, 
+	///breaking lines at spaces so that they fit within it where possible
+	///\param column the column at which the header ends
+	static void writeDescription(std::ostream& os, const std::string& description, size_t column, size_t width){
+		const size_t indent=4;
+		for(size_t pos=0; pos<=description.size(); ){
+			size_t lineEnd=std::min(description.find('\n',pos),description.size());
+			if(pos!=0){
+				os << '\n' << std::string(indent,' ');
+				column=indent;
+			}
+			if(width==0 || column+(pos==0)+(lineEnd-pos)<=width){ //no wrapping needed
+				if(pos==0)
+					os << ' ';
+				os.write(description.data()+pos,lineEnd-pos);
+			}
+			else{
+				//the first line already holds the header
+				bool lineEmpty=(pos!=0);
+				for(size_t i=pos; i<lineEnd; ){
+					size_t wordEnd=std::min(description.find(' ',i),lineEnd);
+					if(wordEnd>i){
+						size_t wordLen=wordEnd-i;
+						size_t needed=wordLen+(lineEmpty?0:1);
+						//start a new line unless doing so cannot help
+						if(column+needed>width && !lineEmpty){
+							os << '\n' << std::string(indent,' ');
+							column=indent;
+							lineEmpty=true;
+							needed=wordLen;
+						}
+						if(!lineEmpty)
+							os << ' ';
+						os.write(description.data()+i,wordLen);
+						column+=needed;
+						lineEmpty=false;
+					}
+					i=wordEnd+1;
+				}
+			}
+			pos=lineEnd+1;
 		}
-		return(ss.str());
 	}
 	
-	///Add whitespace to indent text following newlines
-	static std::string indentDescription(std::string description){
-		size_t pos=0;
-		while((pos=description.find('\n',pos))!=std::string::npos)
-			description.replace(pos++,1,"\n    ");
-		return(description);
+	///Format the help text from the recorded option information
+	///\param width the width to which to wrap descriptions, or zero to not wrap
+	std::string renderUsage(size_t width) const{
+		std::ostringstream ss;
+		ss << baseUsage;
+		for(const UsageEntry& entry : usageEntries){
+			std::string names=synonymList(entry.names);
+			ss << ' ' << names;
+			size_t column=1+names.size()+1;
+			if(entry.takesValue){
+				ss << ' ' << underline(entry.valueName);
+				column+=1+entry.valueName.size();
+			}
+			ss << ':';
+			writeDescription(ss,entry.description,column,width);
+			if(entry.defaultValue){
+				ss << "\n    (default: ";
+				entry.defaultValue->write(*this,ss);
+				ss << ')';
+			}
+			ss << '\n';
+		}
+		if(allowOptionTerminator)
+			ss << " --: Treat all subsequent arguments as positional.\n";
+		if(allowResponseFiles)
+			ss << " @file: Read further arguments from file.\n";
+		return(ss.str());
 	}
 	
 	std::string underline(std::string s) const{
@@ -473,14 +2492,24 @@ private:
 	
 	///An iterator over a stream of tokens derived by applying shell-style splitting
 	///and quoting rules to an underlying stream of characters
-	template<typename CharIterator>
-	struct TokenIterator : public std::iterator<std::input_iterator_tag, const std::string>{
+	template<typename CharIterator, typename String=std::string>
+	struct TokenIterator : public std::iterator<std::input_iterator_tag, const String>{
 	public:
-		TokenIterator(CharIterator c, CharIterator e):cur(c),end(e),done(false){
+		using reference=const String&;
+		using Allocator=typename String::allocator_type;
+		
+		///\param limit the longest token allowed, beyond which reading stops
+		///             with a std::runtime_error
+		TokenIterator(CharIterator c, CharIterator e, const Allocator& alloc=Allocator(),
+		              size_t limit=std::numeric_limits<size_t>::max()):
+		cur(c),end(e),buffers{String(alloc),String(alloc)},maxLength(limit),active(0),done(false){
 			computeNext();
 		}
 		TokenIterator(const TokenIterator& other):
-		cur(other.cur),end(other.end),val(other.val),done(other.done){}
+		cur(other.cur),end(other.end),
+		buffers{String(other.buffers[0],other.buffers[0].get_allocator()),
+		        String(other.buffers[1],other.buffers[1].get_allocator())},
+		maxLength(other.maxLength),active(other.active),done(other.done){}
 		TokenIterator& operator++(){ //preincrement
 			computeNext();
 			return *this;
@@ -491,7 +2520,7 @@ private:
 			return prev;
 		}
 		reference operator*() const{
-			return val;
+			return buffers[active];
 		}
 		bool operator==(const TokenIterator& other) const{
 			if(done || other.done)
@@ -505,6 +2534,10 @@ private:
 		}
 	private:
 		void computeNext(){
+			//keep the previous token alive until the next increment by alternating
+			//between two buffers (swapping them would move short strings)
+			active^=1;
+			String& val=buffers[active];
 			val.clear();
 			if(cur==end){
 				done=true;
@@ -516,8 +2549,19 @@ private:
 			bool inComplexQuote=false;
 			bool inSimpleQuote=false;
 			bool inEscape=false;
+			//whether any quotes were seen, since a pair of empty quotes at the
+			//end of the input forms an (empty) token, unlike whitespace
+			bool quoted=false;
 			while(cur!=end){
-				auto c=*cur++;
+				//characters with no special meaning in the current state can be
+				//copied in bulk
+				if(!inEscape)
+					copyOrdinary(val,inSimpleQuote,inComplexQuote,std::is_pointer<CharIterator>());
+				//stop before an overlong token can grow without bound
+				checkLength(val);
+				if(cur==end)
+					break;
+				char c=*cur++;
 				if(c=='\\'){
 					if(inEscape){ // \\ forms the escape sequence for a backslash itself
 						val+=c;
@@ -534,8 +2578,10 @@ private:
 					else if(inComplexQuote || inEscape){
 						val+=c;
 					}
-					else
+					else{
 						inSimpleQuote=true;
+						quoted=true;
+					}
 					inEscape=false; //if we were in an escape sequence, we now are not
 				}
 				else if(c=='"'){
@@ -554,11 +2600,13 @@ private:
 							val+=c;
 							inEscape=false;
 						}
-						else
+						else{
 							inComplexQuote=true;
+							quoted=true;
+						}
 					}
 				}
-				else if(std::isspace(c)){
+				else if(isSpace(c)){
 					if(inSimpleQuote || inComplexQuote){
 						val+=c;
 						inEscape=false;
@@ -578,47 +2626,175 @@ private:
 					inEscape=false;
 				}
 			}
+			checkLength(val);
+			//trailing whitespace does not form a token
+			if(val.empty() && !quoted)
+				done=true;
+		}
+		
+		///\throws std::runtime_error if a token has grown beyond the limit
+		void checkLength(const String& val) const{
+			if(val.size()>maxLength)
+				throw std::runtime_error("Argument longer than the limit of "
+				  +std::to_string(maxLength)+" characters: '"
+				  +std::string(val.data(),std::min<size_t>(val.size(),32))+"...'");
+		}
+		
+		///Whether a character separates tokens. This is fixed to the whitespace
+		///characters of the "C" locale, regardless of the current locale.
+		static bool isSpace(char c){
+			return(c==' ' || (c>='\t' && c<='\r'));
+		}
+		///Whether a character has a special meaning outside of quotes
+		static bool isSpecial(char c){
+			return(isSpace(c) || c=='\'' || c=='"' || c=='\\');
+		}
+		
+		///Find the first character which has a special meaning outside of 
+		///quotes, examining 16 characters at a time where possible
+		static const char* findSpecial(const char* pos, const char* end){
+#ifdef CL_OPTIONS_USE_SSE2
+			const __m128i space=_mm_set1_epi8(' '), tab=_mm_set1_epi8('\t'), 
+			              controlRange=_mm_set1_epi8('\r'-'\t'),
+			              simpleQuote=_mm_set1_epi8('\''), complexQuote=_mm_set1_epi8('"'),
+			              backslash=_mm_set1_epi8('\\');
+			for(; end-pos>=16; pos+=16){
+				__m128i chunk=_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+				//the control characters \t through \r, as an unsigned range check
+				__m128i offset=_mm_sub_epi8(chunk,tab);
+				__m128i special=_mm_cmpeq_epi8(_mm_min_epu8(offset,controlRange),offset);
+				special=_mm_or_si128(special,_mm_cmpeq_epi8(chunk,space));
+				special=_mm_or_si128(special,_mm_cmpeq_epi8(chunk,simpleQuote));
+				special=_mm_or_si128(special,_mm_cmpeq_epi8(chunk,complexQuote));
+				special=_mm_or_si128(special,_mm_cmpeq_epi8(chunk,backslash));
+				int mask=_mm_movemask_epi8(special);
+				if(mask)
+					return(pos+__builtin_ctz(mask));
+			}
+#endif
+			for(; pos!=end; pos++){
+				if(isSpecial(*pos))
+					break;
+			}
+			return(pos);
+		}
+		
+		///Append the run of characters starting at cur which have no special 
+		///meaning in the current quoting state, and advance past them. At most
+		///one character more than the length limit allows is copied, so that 
+		///an overlong token is detected without reading the rest of it.
+		void copyOrdinary(String& val, bool inSimpleQuote, bool inComplexQuote, std::true_type /*contiguous*/){
+			const char* limit=end;
+			if(val.size()>maxLength)
+				limit=cur;
+			else if(maxLength-val.size()<size_t(end-cur))
+				limit=cur+(maxLength-val.size()+1);
+			const char* runEnd;
+			if(inSimpleQuote){ //only ' is special
+				runEnd=static_cast<const char*>(std::memchr(cur,'\'',limit-cur));
+				if(!runEnd)
+					runEnd=limit;
+			}
+			else if(inComplexQuote){ //only " and \ are special
+				runEnd=cur;
+				while(runEnd!=limit && *runEnd!='"' && *runEnd!='\\')
+					runEnd++;
+			}
+			else
+				runEnd=findSpecial(cur,limit);
+			val.append(cur,runEnd);
+			cur=runEnd;
 		}
+		///Characters from a non-contiguous source are handled one at a time
+		void copyOrdinary(String&, bool, bool, std::false_type /*contiguous*/){}
 		
 		CharIterator cur, end;
-		std::string val;
+		String buffers[2];
+		size_t maxLength;
+		unsigned int active;
 		bool done;
 	};
 	
+	///Whether the tokens referenced by an iterator remain valid after it has
+	///been advanced (as is the case for an array or container of arguments).
+	///This is assumed only of forward iterators which yield references; the
+	///tokens of other iterators are copied when they must be kept. 
+	template<typename Iterator>
+	struct TokensAreStable : public std::integral_constant<bool,
+		std::is_base_of<std::forward_iterator_tag,
+		                typename std::iterator_traits<Iterator>::iterator_category>::value
+		&& std::is_lvalue_reference<typename std::iterator_traits<Iterator>::reference>::value>{};
+	template<typename CharIterator, typename String>
+	struct TokensAreStable<TokenIterator<CharIterator,String>> : public std::false_type{};
+	template<typename Cache>
+	struct TokensAreStable<CachedTokenIterator<Cache>> : public std::false_type{};
+	
 	friend class cl_options_test_access;
+	friend class ConfigWatcher;
 	
 public:
 	///Construct an OptionParser
 	///\param automaticHelp automatically add '-h', '-?', "--help" and "--usage"
 	///                     as options which trigger printing the autogenerated
 	///                     help message
-	explicit OptionParser(bool automaticHelp=true):printedUsage(false),
+	explicit OptionParser(bool automaticHelp=true):targetType(nullptr),frozen(false),printedUsage(false),
+	usageWidth(0),usageRendered(false),
 	allowShortValueWithoutEquals(false),useANSICodes(true),
-	allowShortOptionCombination(false),allowOptionTerminator(false){
+	allowShortOptionCombination(false),allowOptionTerminator(false),
+	allowResponseFiles(false),allowStatisticsOption(false),statistics(nullptr),
+	tokenLengthLimit(std::numeric_limits<size_t>::max()),includeDepthLimit(64),
+	argumentLimit(std::numeric_limits<size_t>::max()),configSuffix(".conf"){
 		if(automaticHelp)
-			addOption({"h","?","help","usage"},
-					  [this](){
-						  std::cout << getUsage() << std::endl;
-						  printedUsage=true;
-					  },
-					  "Print usage information.");
+			addHelpOption({"h","?","help","usage"},"Print usage information.");
 	}
 	
 	///Set the base usage message, printed before the per-option usage information
 	///\param usageMessage_ the message to be shown to the user
-	///\note This function overwrites the entire internal message buffer, so it
-	///\should be called before any calls to `addOption`. 
 	void setBaseUsage(std::string usageMessage_){
-		usageMessage=usageMessage_+'\n';
+		baseUsage=std::move(usageMessage_);
+		baseUsage+='\n';
+		usageRendered=false;
 	}
 	
-	///Get the usage message
+	///Get the usage message, which is generated when first requested after any
+	///change to the options or settings which affect it
 	///\return the usage message including both any message set by `setBaseUsage`
-	///        and any information about individual options appended by `addOption`.
+	///        and any information about individual options added by `addOption`.
 	std::string getUsage(){
+		return(getUsage(0));
+	}
+	
+	///Get the usage message with option descriptions wrapped to a given width
+	///\param width the number of columns into which descriptions should be 
+	///             fitted, or zero to leave them unwrapped
+	///\return the usage message including both any message set by `setBaseUsage`
+	///        and any information about individual options added by `addOption`.
+	std::string getUsage(size_t width){
+		if(!usageRendered || usageWidth!=width){
+			usageMessage=renderUsage(width);
+			usageWidth=width;
+			usageRendered=true;
+		}
 		return(usageMessage);
 	}
 	
+	///Determine the width of the terminal to which standard output is 
+	///connected, falling back to the COLUMNS environment variable
+	///\return the width, or 80 if it cannot be determined
+	static size_t terminalWidth(){
+#ifdef CL_OPTIONS_POSIX
+		struct winsize size;
+		if(ioctl(STDOUT_FILENO,TIOCGWINSZ,&size)==0 && size.ws_col>0)
+			return(size.ws_col);
+#endif
+		if(const char* columns=std::getenv("COLUMNS")){
+			size_t width=0;
+			if(OptionValueConverter<size_t>::convert(columns,columns+std::char_traits<char>::length(columns),width) && width>0)
+				return(width);
+		}
+		return(80);
+	}
+	
 	///Whether the help message was automatically printed
 	bool didPrintUsage() const{
 		return(printedUsage);
@@ -658,17 +2834,91 @@ public:
 	///\param allow whether this feature is enabled
 	void allowsOptionTerminator(bool allow){
 		allowOptionTerminator=allow;
-		if(allowOptionTerminator)
-			usageMessage+=" --: Treat all subsequent arguments as postional.";
+		usageRendered=false;
+	}
+	
+	///Whether arguments of the form '@file' are expanded
+	bool allowsResponseFiles() const{ return(allowResponseFiles); }
+	
+	///Set whether arguments of the form '@file' are expanded, as by GCC: the 
+	///argument is replaced by the arguments read from the file, split and 
+	///quoted as for configuration files. Response files may themselves contain
+	///such arguments, and arguments following an option terminator are not
+	///expanded.
+	///\param allow whether this feature is enabled
+	void allowsResponseFiles(bool allow){
+		allowResponseFiles=allow;
+		usageRendered=false;
 	}
 	
+	///Whether the hidden option '--cl-stats' is recognized
+	bool allowsStatisticsOption() const{ return(allowStatisticsOption); }
+	
+	///Set whether the hidden option '--cl-stats' is recognized, which causes
+	///statistics about the parse in which it appears to be written to 
+	///standard error at the end of the parse, even if the parse fails. 
+	///Statistics are collected from the point where the option appears, so 
+	///nothing is measured in parses which do not use it. The option does not
+	///appear in the help text, and an option registered with the same name 
+	///takes precedence. 
+	///\param allow whether this feature is enabled
+	void allowsStatisticsOption(bool allow){ allowStatisticsOption=allow; }
+	
+	///The longest argument accepted, in characters
+	size_t maxTokenLength() const{ return(tokenLengthLimit); }
+	
+	///Set the longest argument accepted, whether it comes from the command 
+	///line, a file, or the value of an environment variable. Reading a file or stream stops as soon as a token 
+	///grows beyond this length. By default there is no limit.
+	///\param length the greatest number of characters allowed
+	void maxTokenLength(size_t length){ tokenLengthLimit=length; }
+	
+	///The greatest number of configuration and response files which may be 
+	///read inside one another
+	size_t maxIncludeDepth() const{ return(includeDepthLimit); }
+	
+	///Set the greatest number of configuration and response files which may
+	///be read inside one another. The default is 64. 
+	///\param depth the greatest number of files read at once
+	void maxIncludeDepth(size_t depth){ includeDepthLimit=depth; }
+	
+	///The greatest number of arguments accepted by one parse
+	size_t maxArgumentCount() const{ return(argumentLimit); }
+	
+	///Set the greatest number of arguments accepted by one parse, counting 
+	///those read from files, option values given as separate arguments, 
+	///environment variables which set options, and the program name when 
+	///parsing argc and argv. By default there is no limit.
+	///\param count the greatest number of arguments allowed
+	void maxArgumentCount(size_t count){ argumentLimit=count; }
+	
+	///Collect statistics about all subsequent parses (other than the const 
+	///parses with a target object, parseBatch, and sessions, which do not 
+	///modify shared state)
+	///\param stats the object to which statistics are added, which must 
+	///             remain valid until collection is stopped, or null to stop
+	///             collecting statistics
+	void collectStatistics(ParseStatistics* stats){ statistics=stats; }
+	
+	///The suffix which files must have to be read when a configuration file 
+	///option refers to a directory
+	const std::string& configDirectorySuffix() const{ return(configSuffix); }
+	
+	///Set the suffix which files must have to be read when a configuration 
+	///file option refers to a directory
+	///\param suffix the required suffix, which may be empty to read all files
+	void configDirectorySuffix(std::string suffix){ configSuffix=std::move(suffix); }
+	
 	///Whether help text will use ANSI escape sequences for fancier text rendering
 	bool usesANSICodes() const{ return(useANSICodes); }
 	
 	///Set whether help text will use ANSI escape sequences for fancier text 
 	///rendering
 	///\param use whether escape codes will be used
-	void usesANSICodes(bool use){ useANSICodes=use; }
+	void usesANSICodes(bool use){
+		useANSICodes=use;
+		usageRendered=false;
+	}
 	
 	///Add a short option which stores a value to a variable
 	///\param ident the name of the option
@@ -678,12 +2928,8 @@ public:
 	template<typename T>
 	void addOption(char ident, T& destination, std::string description, std::string valueName="value"){
 		checkIdentifier(std::string(1,ident));
-		addOption(ident,destination,shortOptions);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " -" << ident << ' ' << underline(valueName) << ": " << description 
-			<< "\n    (default: " << valueForDisplay(destination) << ")\n";
-		usageMessage+=ss.str();
+		addValueOption(ident,destination);
+		addValueUsage(std::string(1,ident),std::move(description),std::move(valueName),destination);
 	}
 	///Add a short option which invokes a callback which takes no argument
 	///\param ident the name of the option
@@ -691,11 +2937,8 @@ public:
 	///\param description the description of the option
 	void addOption(char ident, std::function<void()> action, std::string description){
 		checkIdentifier(std::string(1,ident));
-		addOption(ident,std::move(action),shortOptionsNoStore);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " -" << ident << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addFlagOption(ident,std::move(action));
+		addUsage(std::string(1,ident),std::move(description),false,std::string());
 	}
 	///Add a short option which invokes a callback which takes a value
 	///\param ident the name of the option
@@ -705,11 +2948,8 @@ public:
 	template<typename DataType>
 	void addOption(char ident, std::function<void(DataType)> action, std::string description, std::string valueName="value"){
 		checkIdentifier(std::string(1,ident));
-		addOption<DataType>(ident,action,shortOptions);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " -" << ident << ' ' << underline(valueName) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addCallbackOption<DataType>(ident,std::move(action));
+		addUsage(std::string(1,ident),std::move(description),true,std::move(valueName));
 	}
 	///Add a short option which reads further configuration from a file whose path is given by a value
 	///\param ident the name of the option
@@ -717,13 +2957,8 @@ public:
 	///\param valueName the name used to document the value
 	void addConfigFileOption(char ident, std::string description, std::string valueName="file"){
 		checkIdentifier(std::string(1,ident));
-		if(optionKnown(ident))
-			throw std::logic_error("Attempt to redefine option '"+asString(ident)+"'");
-		shortOptionsConfig.insert(ident);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " -" << ident << ' ' << underline(valueName) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addConfigOption(ident);
+		addUsage(std::string(1,ident),std::move(description),true,std::move(valueName));
 	}
 	///Add a long option which stores a value to a variable
 	///\param ident the name of the option
@@ -733,12 +2968,8 @@ public:
 	template<typename T>
 	void addOption(std::string ident, T& destination, std::string description, std::string valueName="value"){
 		checkIdentifier(ident);
-		addOption(ident,destination,longOptions);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " --" << ident << ' ' << underline(valueName) << ": " << description 
-			<< "\n    (default: " << valueForDisplay(destination) << ")\n";
-		usageMessage+=ss.str();
+		addValueOption(ident,destination);
+		addValueUsage(std::move(ident),std::move(description),std::move(valueName),destination);
 	}
 	///Add a long option which invokes a callback which takes no argument
 	///\param ident the name of the option
@@ -746,11 +2977,8 @@ public:
 	///\param description the description of the option
 	void addOption(std::string ident, std::function<void()> action, std::string description){
 		checkIdentifier(ident);
-		addOption(ident,std::move(action),longOptionsNoStore);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " --" << ident << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addFlagOption(ident,std::move(action));
+		addUsage(std::move(ident),std::move(description),false,std::string());
 	}
 	///Add a long option which invokes a callback which takes a value
 	///\param ident the name of the option
@@ -760,11 +2988,8 @@ public:
 	template<typename DataType>
 	void addOption(std::string ident, std::function<void(DataType)> action, std::string description, std::string valueName="value"){
 		checkIdentifier(ident);
-		addOption<DataType>(ident,std::move(action),longOptions);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " --" << ident << ' ' << underline(valueName) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addCallbackOption<DataType>(ident,std::move(action));
+		addUsage(std::move(ident),std::move(description),true,std::move(valueName));
 	}
 	///Add a long option which reads further configuration from a file whose path is given by a value
 	///\param ident the name of the option
@@ -772,13 +2997,8 @@ public:
 	///\param valueName the name used to document the value
 	void addConfigFileOption(std::string ident, std::string description, std::string valueName="file"){
 		checkIdentifier(ident);
-		if(optionKnown(ident))
-			throw std::logic_error("Attempt to redefine option '"+asString(ident)+"'");
-		longOptionsConfig.insert(ident);
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss  << " --" << ident << ' ' << underline(valueName) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addConfigOption(ident);
+		addUsage(std::move(ident),std::move(description),true,std::move(valueName));
 	}
 	///Add an option with multiple synonyms which stores a value to a variable
 	///\param idents all of the names for the option
@@ -788,17 +3008,8 @@ public:
 	void addOption(std::initializer_list<std::string> idents, T& destination, std::string description, std::string valueName="value"){
 		for(auto ident : idents)
 			checkIdentifier(ident);
-		for(auto ident : idents){
-			if(ident.size()==1)
-				addOption(ident[0],destination,shortOptions);
-			else
-				addOption(ident,destination,longOptions);
-		}
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss << ' ' << synonymList(idents) << ' ' << underline(valueName) << ": " << description 
-			<< "\n    (default: " << valueForDisplay(destination) << ")\n";
-		usageMessage+=ss.str();
+		addValueOption(idents,destination);
+		addValueUsage(joinNames(idents),std::move(description),std::move(valueName),destination);
 	}
 	///Add an option with multiple synonyms which invokes a callback which takes no argument
 	///\param idents all of the names for the option
@@ -807,16 +3018,8 @@ public:
 	void addOption(std::initializer_list<std::string> idents, std::function<void()> action, std::string description){
 		for(auto ident : idents)
 			checkIdentifier(ident);
-		for(auto ident : idents){
-			if(ident.size()==1)
-				addOption(ident[0],action,shortOptionsNoStore);
-			else
-				addOption(ident,action,longOptionsNoStore);
-		}
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss << ' ' << synonymList(idents) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addFlagOption(idents,std::move(action));
+		addUsage(joinNames(idents),std::move(description),false,std::string());
 	}
 	///Add an option with multiple synonyms which invokes a callback which takes a value
 	///\param idents all of the names for the option
@@ -826,16 +3029,8 @@ public:
 	void addOption(std::initializer_list<std::string> idents, std::function<void(DataType)> action, std::string description, std::string valueName="value"){
 		for(auto ident : idents)
 			checkIdentifier(ident);
-		for(auto ident : idents){
-			if(ident.size()==1)
-				addOption<DataType>(ident[0],action,shortOptions);
-			else
-				addOption<DataType>(ident,action,longOptions);
-		}
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss << ' ' << synonymList(idents) << ' ' << underline(valueName) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		addCallbackOption<DataType>(idents,std::move(action));
+		addUsage(joinNames(idents),std::move(description),true,std::move(valueName));
 	}
 	///Add an option with multiple synonyms which reads further configuration from a file whose path is given by a value
 	///\param ident the name of the option
@@ -844,20 +3039,125 @@ public:
 	void addConfigFileOption(std::initializer_list<std::string> idents, std::string description, std::string valueName="file"){
 		for(auto ident : idents)
 			checkIdentifier(ident);
-		for(auto ident : idents){
-			if(optionKnown(ident))
-				throw std::logic_error("Attempt to redefine option '"+asString(ident)+"'");
-			if(ident.size()==1)
-				shortOptionsConfig.insert(ident[0]);
+		addConfigOption(idents);
+		addUsage(joinNames(idents),std::move(description),true,std::move(valueName));
+	}
+	
+	///Add a short option which stores a value to a member of the target object
+	///passed to each parse
+	///\param ident the name of the option
+	///\param member the member to which the option's value will be stored
+	///\param description the description of the option
+	///\param valueName the name used to document the value
+	///\throws std::logic_error if options acting on a different type of 
+	///       target have already been added
+	template<typename Target, typename T>
+	void addOption(char ident, T Target::* member, std::string description, std::string valueName="value"){
+		addOption({std::string(1,ident)},member,std::move(description),std::move(valueName));
+	}
+	///Add a short option which invokes a callback with the target object 
+	///passed to each parse
+	///\param ident the name of the option
+	///\param action the callback function
+	///\param description the description of the option
+	template<typename Target>
+	void addTargetAction(char ident, std::function<void(Target&)> action, std::string description){
+		addTargetAction({std::string(1,ident)},std::move(action),std::move(description));
+	}
+	///Add a long option which stores a value to a member of the target object
+	///passed to each parse
+	///\param ident the name of the option
+	///\param member the member to which the option's value will be stored
+	///\param description the description of the option
+	///\param valueName the name used to document the value
+	template<typename Target, typename T>
+	void addOption(std::string ident, T Target::* member, std::string description, std::string valueName="value"){
+		addOption({ident},member,std::move(description),std::move(valueName));
+	}
+	///Add a long option which invokes a callback with the target object 
+	///passed to each parse
+	///\param ident the name of the option
+	///\param action the callback function
+	///\param description the description of the option
+	template<typename Target>
+	void addTargetAction(std::string ident, std::function<void(Target&)> action, std::string description){
+		addTargetAction({ident},std::move(action),std::move(description));
+	}
+	///Add an option with multiple synonyms which stores a value to a member of
+	///the target object passed to each parse
+	///\param idents the names of the option
+	///\param member the member to which the option's value will be stored
+	///\param description the description of the option
+	///\param valueName the name used to document the value
+	template<typename Target, typename T>
+	void addOption(std::initializer_list<std::string> idents, T Target::* member, std::string description, std::string valueName="value"){
+		addTargetOption<Target>(idents,OptionKind::Value,OptionHandler::make(StoreToMember<Target,T>{member}));
+		addUsage(joinNames(idents),std::move(description),true,std::move(valueName));
+	}
+	///Add an option with multiple synonyms which invokes a callback with the 
+	///target object passed to each parse
+	///\param idents the names of the option
+	///\param action the callback function
+	///\param description the description of the option
+	template<typename Target>
+	void addTargetAction(std::initializer_list<std::string> idents, std::function<void(Target&)> action, std::string description){
+		addTargetOption<Target>(idents,OptionKind::Flag,OptionHandler::make(InvokeTargetAction<Target>{std::move(action)}));
+		addUsage(joinNames(idents),std::move(description),false,std::string());
+	}
+	
+	///Compile all registered options into lookup tables: a sorted table for
+	///long options and a table indexed directly by character for short options.
+	///This is done automatically before parsing if any options have been added
+	///since the last call, but may be called explicitly to pay the cost up 
+	///front.
+	void freeze(){
+		lookupTable.clear();
+		lookupTable.reserve(optionNames.size());
+		shortTable.fill(LookupRecord{0,0,true,OptionKind::Flag,0});
+		frozenNames.clear();
+		for(const auto& name : optionNames){
+			LookupRecord record{(uint32_t)frozenNames.size(),(uint32_t)name.name.size(),
+			                    name.isShort,options[name.entry].kind,name.entry};
+			if(name.isShort)
+				shortTable[(unsigned char)name.name[0]]=record;
 			else
-				longOptionsConfig.insert(ident);
+				lookupTable.push_back(record);
+			frozenNames+=name.name;
 		}
-		description=indentDescription(description);
-		std::ostringstream ss;
-		ss << ' ' << synonymList(idents) << ' ' << underline(valueName) << ": " << description << '\n';
-		usageMessage+=ss.str();
+		//map environment variable names to long options, noting names to 
+		//which more than one option corresponds
+		environmentTable.clear();
+		environmentTable.reserve(lookupTable.size());
+		environmentNames.clear();
+		for(uint32_t i=0; i<lookupTable.size(); i++){
+			const LookupRecord& record=lookupTable[i];
+			//asking for help makes no sense for a variable, and names like 
+			//FOO_HELP are too likely to be used for other purposes
+			if(record.kind==OptionKind::Help)
+				continue;
+			uint32_t offset=environmentNames.size();
+			appendEnvironmentName(environmentNames,frozenNames.data()+record.nameOffset,record.nameLength);
+			environmentTable.push_back(EnvironmentRecord{offset,record.nameLength,i});
+		}
+		auto envLess=[this](const EnvironmentRecord& a, const EnvironmentRecord& b){
+			return(nameOrder(false,environmentNames.data()+a.nameOffset,a.nameLength,
+			                 false,environmentNames.data()+b.nameOffset,b.nameLength)<0);
+		};
+		std::sort(environmentTable.begin(),environmentTable.end(),envLess);
+		auto out=environmentTable.begin();
+		for(auto it=environmentTable.begin(); it!=environmentTable.end(); ++it){
+			if(out!=environmentTable.begin() && !envLess(*(out-1),*it))
+				(out-1)->record=ambiguousEnvironmentName;
+			else
+				*out++=*it;
+		}
+		environmentTable.erase(out,environmentTable.end());
+		frozen=true;
 	}
 	
+	///Whether the lookup table is up to date with all registered options
+	bool isFrozen() const{ return(frozen); }
+	
 	///Parse a collection of arguments
 	///\param argBegin an iterator referencing the first argument
 	///\param argEnd an iterator referencing the point after all arguments
@@ -865,8 +3165,24 @@ public:
 	///        the input
 	template<typename Iterator>
 	std::vector<std::string> parseArgs(Iterator argBegin, Iterator argEnd){
-		ParsingState ps;
-		return(parseArgs(ps,argBegin,argEnd));
+		return(parseArgs(argBegin,argEnd,std::allocator<char>()));
+	}
+	///Parse a collection of arguments, allocating the results and all 
+	///intermediate storage from a given allocator
+	///\param argBegin an iterator referencing the first argument
+	///\param argEnd an iterator referencing the point after all arguments
+	///\param alloc the allocator to use, for example a 
+	///             std::pmr::polymorphic_allocator<char> backed by an arena
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Iterator, typename Allocator>
+	PositionalList<Allocator> parseArgs(Iterator argBegin, Iterator argEnd, const Allocator& alloc){
+		prepareParse();
+		ParsingState<Allocator> ps(alloc);
+		beginParse(ps);
+		parseTokens(ps,argBegin,argEnd);
+		concludeParse(ps);
+		return(std::move(ps.positionals));
 	}
 	///Parse a collection of arguments
 	///\param argc the number of arguments
@@ -884,6 +3200,416 @@ public:
 	std::vector<std::string> parseArgs(int argc, const char* argv[]){
 		return(parseArgs(argv,argv+argc));
 	}
+	///Parse a collection of arguments using a given allocator
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\param alloc the allocator to use
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Allocator>
+	PositionalList<Allocator> parseArgs(int argc, char* argv[], const Allocator& alloc){
+		return(parseArgs(argv,argv+argc,alloc));
+	}
+	///Parse a collection of arguments using a given allocator
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\param alloc the allocator to use
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Allocator>
+	PositionalList<Allocator> parseArgs(int argc, const char* argv[], const Allocator& alloc){
+		return(parseArgs(argv,argv+argc,alloc));
+	}
+	///Parse a collection of arguments on behalf of a target object, on which 
+	///options added with member pointers or target callbacks act. This does 
+	///not modify the parser, so once it has been frozen any number of threads
+	///may parse concurrently, each with its own target; the handlers of 
+	///options not bound to the target must then be safe to call concurrently.
+	///\param target the object on which options act
+	///\param argBegin an iterator referencing the first argument
+	///\param argEnd an iterator referencing the point after all arguments
+	///\param printedUsage if not null, set to whether the help message was 
+	///                    printed
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	///\throws std::logic_error if the parser has not been frozen since the 
+	///       last option was added, or if the target is not of the type used 
+	///       when adding options
+	template<typename Target, typename Iterator>
+	std::vector<std::string> parseArgs(Target& target, Iterator argBegin, Iterator argEnd, bool* printedUsage=nullptr) const{
+		checkTarget<Target>();
+		ParsingState<std::allocator<char>> ps{std::allocator<char>()};
+		ps.target=&target;
+		parseTokens(ps,argBegin,argEnd);
+		if(printedUsage)
+			*printedUsage=ps.printedUsage;
+		return(std::move(ps.positionals));
+	}
+	///Parse a collection of arguments on behalf of a target object
+	///\param target the object on which options act
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\param printedUsage if not null, set to whether the help message was 
+	///                    printed
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Target>
+	std::vector<std::string> parseArgs(Target& target, int argc, char* argv[], bool* printedUsage=nullptr) const{
+		return(parseArgs(target,argv,argv+argc,printedUsage));
+	}
+	///Parse a collection of arguments on behalf of a target object
+	///\param target the object on which options act
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\param printedUsage if not null, set to whether the help message was 
+	///                    printed
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Target>
+	std::vector<std::string> parseArgs(Target& target, int argc, const char* argv[], bool* printedUsage=nullptr) const{
+		return(parseArgs(target,argv,argv+argc,printedUsage));
+	}
+	
+	///The outcome of parsing one record of a batch
+	template<typename Target>
+	struct BatchResult{
+		///the object on which the record's options acted
+		Target target;
+		///the positional arguments of the record
+		std::vector<std::string> positionals;
+		///the error which stopped the record from being parsed, or empty if 
+		///it was parsed successfully
+		std::string error;
+		///whether the record requested the help message, which is not 
+		///printed for records of a batch
+		bool printedUsage;
+		///if the record used '--cl-stats', the statistics of its parse, which 
+		///are not written to standard error for records of a batch
+		std::shared_ptr<const ParseStatistics> statistics;
+		
+		///Whether the record was parsed successfully
+		bool ok() const{ return(error.empty()); }
+	};
+	
+	///Parse many independent records in parallel, each into its own copy of a
+	///prototype target object. Errors are reported for each record rather 
+	///than thrown, so one bad record does not prevent the others from being
+	///parsed. The help option does not print the help message, since records
+	///parsed concurrently would interleave it; a record which requests it 
+	///instead has printedUsage set in its result. Similarly, a record which 
+	///uses '--cl-stats' has its statistics returned in its result rather than
+	///written to standard error.
+	///\param recordBegin a forward iterator referencing the first record; 
+	///                   each record is either a command line (anything 
+	///                   convertible to StringView), which is split with the 
+	///                   same rules as configuration files, or a collection of
+	///                   arguments
+	///\param recordEnd an iterator referencing the point after all records
+	///\param prototype the initial state of the target for every record
+	///\return the result of each record, in the same order as the records
+	///\throws std::logic_error if the parser has not been frozen since the 
+	///       last option was added, or if the target is not of the type used 
+	///       when adding options
+	template<typename Target, typename Iterator>
+	std::vector<BatchResult<Target>> parseBatch(Iterator recordBegin, Iterator recordEnd, const Target& prototype) const{
+		checkTarget<Target>();
+		using Record=typename std::iterator_traits<Iterator>::value_type;
+		std::vector<const Record*> records;
+		for(; recordBegin!=recordEnd; ++recordBegin)
+			records.push_back(&*recordBegin);
+		std::vector<BatchResult<Target>> results(records.size(),
+		  BatchResult<Target>{prototype,{},std::string(),false,nullptr});
+		//records are typically small, so claim them in blocks to keep the 
+		//threads from contending for the next index
+		runConcurrently(records.size(),[&](size_t i){
+			BatchResult<Target>& result=results[i];
+			ParsingState<std::allocator<char>> ps{std::allocator<char>()};
+			ps.target=&result.target;
+			ps.showUsage=false;
+			try{
+				parseRecord(ps,*records[i],std::is_convertible<Record,StringView>());
+				result.positionals=std::move(ps.positionals);
+				result.printedUsage=ps.printedUsage;
+			}catch(std::exception& ex){
+				result.error=ex.what();
+			}catch(...){
+				result.error="Unknown exception";
+			}
+			//likewise, statistics requested by a record are returned rather 
+			//than written
+			if(ps.reportStatistics){
+				ps.reportStatistics=false;
+				ps.concludeStatistics();
+				result.statistics=std::move(ps.ownStatistics);
+			}
+		},64);
+		return(results);
+	}
+	///Parse many records in parallel, one per line of a stream, such as a job
+	///manifest. The stream is read in chunks of lines, each parsed before the
+	///next is read, so only one chunk of the manifest is held in memory at a
+	///time (the results for all lines are still returned together).
+	///\param stream the stream from which to read the records
+	///\param prototype the initial state of the target for every record
+	///\return the result of each line, in order
+	template<typename Target>
+	std::vector<BatchResult<Target>> parseBatch(std::istream& stream, const Target& prototype) const{
+		const size_t chunkSize=16384;
+		std::vector<BatchResult<Target>> results;
+		std::vector<std::string> lines;
+		lines.reserve(chunkSize);
+		std::string line;
+		while(stream){
+			lines.clear();
+			while(lines.size()<chunkSize && std::getline(stream,line))
+				lines.push_back(std::move(line));
+			if(lines.empty())
+				break;
+			std::vector<BatchResult<Target>> chunk=parseBatch(lines.begin(),lines.end(),prototype);
+			results.insert(results.end(),std::make_move_iterator(chunk.begin()),
+			               std::make_move_iterator(chunk.end()));
+		}
+		return(results);
+	}
+	
+	///A context for parsing many argument lists in turn with one parser, on 
+	///behalf of a target object as with the const form of parseArgs. All 
+	///memory used by a parse (for the positional arguments, the tokenizer's 
+	///buffers, the state of configuration files being read, and so on) is 
+	///taken sequentially from blocks owned by the session, which are kept 
+	///rather than freed when the next parse begins, so that once a session 
+	///has warmed up, parses of similar size allocate no memory. A session may
+	///be used by only one thread at a time, but each thread may have its own.
+	class Session{
+		///The blocks of memory from which a session allocates
+		class Arena{
+		public:
+			Arena():current(0),used(0){}
+			///Ensure that at least a given number of bytes are available 
+			///without further allocation
+			void reserve(size_t size){
+				if(blocks.empty() && size)
+					blocks.push_back(Block{std::unique_ptr<char[]>(new char[size]),size});
+			}
+			void* allocate(size_t size, size_t alignment){
+				while(current<blocks.size()){
+					Block& block=blocks[current];
+					size_t offset=(used+alignment-1)/alignment*alignment;
+					if(offset+size<=block.size){
+						used=offset+size;
+						return(block.data.get()+offset);
+					}
+					current++;
+					used=0;
+				}
+				size_t lastSize=(blocks.empty()?0:blocks.back().size);
+				size_t blockSize=std::max(std::max<size_t>(4096,2*lastSize),size+alignment);
+				blocks.push_back(Block{std::unique_ptr<char[]>(new char[blockSize]),blockSize});
+				current=blocks.size()-1;
+				//new[] aligns for any fundamental type
+				used=size;
+				return(blocks.back().data.get());
+			}
+			///Make all memory available for reuse, merging the blocks into
+			///one large enough for all of them, so that a parse which needed
+			///several blocks will not need to move between them next time
+			void reset(){
+				if(blocks.size()>1){
+					size_t total=capacity();
+					blocks.clear();
+					blocks.push_back(Block{std::unique_ptr<char[]>(new char[total]),total});
+				}
+				current=0;
+				used=0;
+			}
+			///The total size of all blocks
+			size_t capacity() const{
+				size_t total=0;
+				for(const Block& block : blocks)
+					total+=block.size;
+				return(total);
+			}
+		private:
+			struct Block{
+				std::unique_ptr<char[]> data;
+				size_t size;
+			};
+			std::vector<Block> blocks;
+			///the index of the block from which memory is being taken
+			size_t current;
+			///the number of bytes used in the current block
+			size_t used;
+		};
+	public:
+		///The allocator used for all memory in a session's parses. Memory is
+		///only reclaimed when the session is reset.
+		template<typename T>
+		class Allocator{
+		public:
+			using value_type=T;
+			using propagate_on_container_copy_assignment=std::true_type;
+			using propagate_on_container_move_assignment=std::true_type;
+			using propagate_on_container_swap=std::true_type;
+			
+			explicit Allocator(Arena* a):arena(a){}
+			template<typename U>
+			Allocator(const Allocator<U>& other):arena(other.arena){}
+			T* allocate(size_t n){
+				return(static_cast<T*>(arena->allocate(n*sizeof(T),alignof(T))));
+			}
+			void deallocate(T*, size_t){}
+			template<typename U>
+			bool operator==(const Allocator<U>& other) const{ return(arena==other.arena); }
+			template<typename U>
+			bool operator!=(const Allocator<U>& other) const{ return(arena!=other.arena); }
+		private:
+			template<typename U>
+			friend class Allocator;
+			Arena* arena;
+		};
+		///The list of positional arguments produced by a parse
+		using Positionals=PositionalList<Allocator<char>>;
+		
+		///\param parser the parser to use, which must outlive the session and
+		///              must not have options added while it is in use
+		///\param reserve the number of bytes of memory to set aside for parsing
+		///               immediately, so that even the first parse need not 
+		///               allocate if it fits
+		explicit Session(const OptionParser& parser, size_t reserve=0):
+		parser(parser),positionalList(Allocator<char>(&arena)),usagePrinted(false){
+			arena.reserve(reserve);
+		}
+		Session(const Session&)=delete;
+		Session& operator=(const Session&)=delete;
+		
+		///Parse a collection of arguments on behalf of a target object, 
+		///discarding the results of any previous parse
+		///\param target the object on which options act
+		///\param argBegin an iterator referencing the first argument
+		///\param argEnd an iterator referencing the point after all arguments
+		///\return the positional arguments in the order they were encountered
+		///        in the input, valid until the session is next used or reset
+		///\throws std::logic_error if the parser has not been frozen since the
+		///       last option was added, or if the target is not of the type 
+		///       used when adding options
+		template<typename Target, typename Iterator>
+		const Positionals& parse(Target& target, Iterator argBegin, Iterator argEnd){
+			parser.checkTarget<Target>();
+			reset();
+			State ps{Allocator<char>(&arena)};
+			ps.target=&target;
+			parser.parseTokens(ps,argBegin,argEnd);
+			return(finish(ps));
+		}
+		///Parse a collection of arguments on behalf of a target object
+		///\param target the object on which options act
+		///\param argc the number of arguments
+		///\param argv the array of arguments
+		///\return the positional arguments, valid until the session is next 
+		///        used or reset
+		template<typename Target>
+		const Positionals& parse(Target& target, int argc, char* argv[]){
+			return(parse(target,argv,argv+argc));
+		}
+		///Parse a collection of arguments on behalf of a target object
+		///\param target the object on which options act
+		///\param argc the number of arguments
+		///\param argv the array of arguments
+		///\return the positional arguments, valid until the session is next 
+		///        used or reset
+		template<typename Target>
+		const Positionals& parse(Target& target, int argc, const char* argv[]){
+			return(parse(target,argv,argv+argc));
+		}
+		///Parse a collection of arguments for a parser whose options are not 
+		///bound to a target object, discarding the results of any previous 
+		///parse. Once the session has warmed up (or if it reserved enough 
+		///memory), parsing flags and numeric values in this way allocates no
+		///memory at all.
+		///\param argBegin an iterator referencing the first argument
+		///\param argEnd an iterator referencing the point after all arguments
+		///\return the positional arguments in the order they were encountered
+		///        in the input, valid until the session is next used or reset
+		///\throws std::logic_error if the parser has not been frozen since the
+		///       last option was added, or if it has options bound to a target
+		template<typename Iterator>
+		const Positionals& parse(Iterator argBegin, Iterator argEnd){
+			if(!parser.frozen)
+				throw std::logic_error("The parser must be frozen before it is used by a session");
+			if(parser.targetType)
+				throw std::logic_error("Options which act on a target object require a target to be passed to parse");
+			reset();
+			State ps{Allocator<char>(&arena)};
+			parser.parseTokens(ps,argBegin,argEnd);
+			return(finish(ps));
+		}
+		///Parse a collection of arguments for a parser whose options are not 
+		///bound to a target object
+		///\param argc the number of arguments
+		///\param argv the array of arguments
+		///\return the positional arguments, valid until the session is next 
+		///        used or reset
+		const Positionals& parse(int argc, char* argv[]){
+			return(parse(argv,argv+argc));
+		}
+		///Parse a collection of arguments for a parser whose options are not 
+		///bound to a target object
+		///\param argc the number of arguments
+		///\param argv the array of arguments
+		///\return the positional arguments, valid until the session is next 
+		///        used or reset
+		const Positionals& parse(int argc, const char* argv[]){
+			return(parse(argv,argv+argc));
+		}
+		///Parse a command line on behalf of a target object, splitting it with
+		///the same rules as configuration files
+		///\param target the object on which options act
+		///\param commandLine the arguments to parse
+		///\return the positional arguments, valid until the session is next 
+		///        used or reset
+		template<typename Target>
+		const Positionals& parse(Target& target, StringView commandLine){
+			parser.checkTarget<Target>();
+			reset();
+			State ps{Allocator<char>(&arena)};
+			ps.target=&target;
+			using TokenIterator=OptionParser::TokenIterator<const char*,typename State::String>;
+			parser.parseTokens(ps,TokenIterator(commandLine.begin(),commandLine.end(),ps.allocator,parser.tokenLengthLimit),
+			                   TokenIterator(commandLine.end(),commandLine.end(),ps.allocator));
+			return(finish(ps));
+		}
+		
+		///The positional arguments from the most recent parse
+		const Positionals& positionals() const{ return(positionalList); }
+		///Whether the most recent parse printed the help message
+		bool printedUsage() const{ return(usagePrinted); }
+		///Discard the results of the most recent parse, keeping the memory 
+		///they used for the next parse
+		void reset(){
+			//nothing is freed individually, so the list may simply be 
+			//abandoned once its contents are destroyed
+			positionalList.clear();
+			Positionals(Allocator<char>(&arena)).swap(positionalList);
+			usagePrinted=false;
+			arena.reset();
+		}
+		///The number of bytes of memory retained for parsing
+		size_t capacity() const{ return(arena.capacity()); }
+	private:
+		using State=ParsingState<Allocator<char>>;
+		
+		const Positionals& finish(State& ps){
+			positionalList=std::move(ps.positionals);
+			usagePrinted=ps.printedUsage;
+			return(positionalList);
+		}
+		
+		const OptionParser& parser;
+		Arena arena;
+		Positionals positionalList;
+		bool usagePrinted;
+	};
+	
 	///Parse a collection of arguments from a character stream, with basic
 	///shell-style splitting and quoting rules
 	///\param stream the input stream from which to read options
@@ -891,11 +3617,21 @@ public:
 	///        the input
 	template<typename IStream>
 	std::vector<std::string> parseArgsFromStream(IStream& stream){
+		return(parseArgsFromStream(stream,std::allocator<char>()));
+	}
+	///Parse a collection of arguments from a character stream using a given
+	///allocator
+	///\param stream the input stream from which to read options
+	///\param alloc the allocator to use, also for the tokenizer's buffers
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename IStream, typename Allocator>
+	PositionalList<Allocator> parseArgsFromStream(IStream& stream, const Allocator& alloc){
 		using CharIterator=std::istreambuf_iterator<char>;
-		using TokenIterator=TokenIterator<CharIterator>;
+		using TokenIterator=TokenIterator<CharIterator,BasicString<Allocator>>;
 		CharIterator cit(stream), cend;
-		TokenIterator it(cit,cend), end(cend,cend);
-		return(parseArgs(it,end));
+		TokenIterator it(cit,cend,alloc,tokenLengthLimit), end(cend,cend,alloc);
+		return(parseArgs(it,end,alloc));
 	}
 	///Parse a collection of arguments from a file, with basic shell-style
 	///splitting and quoting rules
@@ -903,16 +3639,131 @@ public:
 	///\return the positional arguments in the order they were encountered in 
 	///        the input
 	std::vector<std::string> parseArgsFromFile(std::string path){
-		std::ifstream infile(path);
-		if(!infile)
-			throw std::runtime_error("Unable to read "+path);
-		using CharIterator=std::istreambuf_iterator<char>;
-		using TokenIterator=TokenIterator<CharIterator>;
-		CharIterator cit(infile), cend;
-		TokenIterator it(cit,cend), end(cend,cend);
-		ParsingState ps;
-		ps.fileStack.push_back(path);
-		return(parseArgs(ps,it,end));
+		return(parseArgsFromFile(path,std::allocator<char>()));
+	}
+	///Parse a collection of arguments from a file using a given allocator
+	///\param path the path to the file from which to read options
+	///\param alloc the allocator to use
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Allocator>
+	PositionalList<Allocator> parseArgsFromFile(StringView path, const Allocator& alloc){
+		prepareParse();
+		ParsingState<Allocator> ps(alloc);
+		beginParse(ps);
+		parseArgsFromFile(ps,path);
+		concludeParse(ps);
+		return(std::move(ps.positionals));
+	}
+	
+	///Parse a collection of arguments, returning views of the positional 
+	///arguments rather than copies
+	///\param argBegin an iterator referencing the first argument
+	///\param argEnd an iterator referencing the point after all arguments
+	///\return the positional arguments in the order they were encountered in 
+	///        the input; those which were not read from configuration files 
+	///        refer directly to the input arguments if the iterator is a 
+	///        forward iterator yielding references, and are copied otherwise
+	template<typename Iterator>
+	PositionalViews parseArgsAsViews(Iterator argBegin, Iterator argEnd){
+		prepareParse();
+		ViewParsingState ps;
+		beginParse(ps);
+		parseTokens(ps,argBegin,argEnd);
+		concludeParse(ps);
+		return(std::move(ps.views));
+	}
+	///Parse a collection of arguments, returning views of the positional 
+	///arguments rather than copies
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	PositionalViews parseArgsAsViews(int argc, char* argv[]){
+		return(parseArgsAsViews(argv,argv+argc));
+	}
+	///Parse a collection of arguments, returning views of the positional 
+	///arguments rather than copies
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	PositionalViews parseArgsAsViews(int argc, const char* argv[]){
+		return(parseArgsAsViews(argv,argv+argc));
+	}
+	///Parse a collection of arguments from a file, returning views of the 
+	///positional arguments, which are packed into storage owned by the result
+	///\param path the path to the file from which to read options
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	PositionalViews parseArgsFromFileAsViews(StringView path){
+		prepareParse();
+		ViewParsingState ps;
+		beginParse(ps);
+		parseArgsFromFile(ps,path);
+		concludeParse(ps);
+		return(std::move(ps.views));
+	}
+	
+	///Parse options from environment variables. Each long option corresponds
+	///to a variable whose name is the prefix followed by the option name in 
+	///upper case with dashes replaced by underscores; for example, with the 
+	///prefix "MYTOOL_" the option "dry-run" is set by MYTOOL_DRY_RUN. A flag
+	///is invoked if its variable is empty, "1", or "true", and not if it is 
+	///"0" or "false". Variables which do not correspond to options, or which 
+	///correspond to the automatic help option, are ignored. Each variable which sets an option counts as one argument for
+	///the limits on argument length and count.
+	///\param prefix the prefix shared by all relevant variable names
+	///\return the positional arguments from any configuration files read
+	std::vector<std::string> parseEnvironment(StringView prefix){
+		return(parseEnvironment(prefix,processEnvironment()));
+	}
+	///Parse options from a given set of environment variables
+	///\param prefix the prefix shared by all relevant variable names
+	///\param environment a null-terminated array of "NAME=value" strings, in 
+	///                   the form of the third argument to main or environ
+	///\return the positional arguments from any configuration files read
+	std::vector<std::string> parseEnvironment(StringView prefix, const char* const* environment){
+		prepareParse();
+		ParsingState<std::allocator<char>> ps{std::allocator<char>()};
+		beginParse(ps);
+		parseEnvironment(ps,prefix,environment);
+		concludeParse(ps);
+		return(std::move(ps.positionals));
+	}
+	
+	///Parse a collection of arguments from a file, replaying a binary snapshot
+	///of the tokens of the file and all files it includes when possible.
+	///The snapshot is used only if none of the files it records have changed
+	///(as judged by their identities, modification times, and sizes); 
+	///otherwise the file is parsed normally and a new snapshot is written. 
+	///Snapshots are only used on POSIX systems.
+	///\param path the path to the file from which to read options
+	///\param snapshotPath the path at which the snapshot is stored
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	std::vector<std::string> parseArgsFromFileWithSnapshot(StringView path, StringView snapshotPath){
+		return(parseArgsFromFileWithSnapshot(path,snapshotPath,std::allocator<char>()));
+	}
+	///Parse a collection of arguments from a file using a given allocator, 
+	///replaying a binary snapshot of its tokens when possible
+	///\param path the path to the file from which to read options
+	///\param snapshotPath the path at which the snapshot is stored
+	///\param alloc the allocator to use
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Allocator>
+	PositionalList<Allocator> parseArgsFromFileWithSnapshot(StringView path, StringView snapshotPath, const Allocator& alloc){
+		prepareParse();
+		ParsingState<Allocator> ps(alloc);
+		beginParse(ps);
+		size_t snapshotFiles=(loadSnapshot(ps,snapshotPath) ? ps.fileCache.size() : 0);
+		parseArgsFromFile(ps,path);
+		//rewrite the snapshot if it was invalid or any file had to be read
+		if(snapshotFiles==0 || ps.fileCache.size()!=snapshotFiles)
+			writeSnapshot(ps,snapshotPath);
+		concludeParse(ps);
+		return(std::move(ps.positionals));
 	}
 };
 
@@ -944,4 +3795,673 @@ typename OptionParser::valueForDisplay_traits<std::string>::Result OptionParser:
 	return ss.str();
 }
 
+///Watches the files read for a configuration and applies changes to them 
+///while a program runs. 
+///
+/// The configuration file is parsed when the watcher is constructed, exactly 
+/// as by `OptionParser::parseArgsFromFile`. Each later call to `poll` checks 
+/// whether any of the files read (including files and directories reached 
+/// through configuration file options) have changed, and if so parses the 
+/// configuration again. Only files which changed are read and tokenized again,
+/// and only options whose uses changed have their handlers invoked: options 
+/// taking values when the sequence of values given to them differs, and flags
+/// when the number of times they are used differs. Each such option has all of
+/// its uses replayed in order. Options removed from the configuration keep 
+/// their current values. 
+///
+/// On Linux, changes are detected with inotify, and `fileDescriptor` may be 
+/// added to a poll/select/epoll set to learn when to call `poll`. Elsewhere,
+/// every call to `poll` parses the configuration again (which is still cheap
+/// for unchanged files, whose tokens are kept). 
+///
+/// The OptionParser must outlive the watcher, and the watcher must only be 
+/// used from one thread at a time.
+class ConfigWatcher{
+public:
+	///The outcome of checking for changes
+	struct ReloadResult{
+		///whether the configuration was parsed again
+		bool reloaded;
+		///the first name of each option whose handler was invoked
+		std::vector<std::string> changedOptions;
+		///if the new configuration could not be parsed or applied, the reason.
+		///In that case the previous configuration remains in effect: values
+		///are checked before any are applied, so nothing was applied unless
+		///a callback itself failed. 
+		std::string error;
+	};
+	
+	///Parse a configuration file and begin watching it
+	///\param parser the parser with which to interpret the configuration
+	///\param path the path to the configuration file
+	///\throws std::runtime_error if the configuration cannot be parsed
+	ConfigWatcher(OptionParser& parser, std::string path):
+	parser(parser),path(std::move(path)),recording(true),
+	cache(0,OptionParser::FileIdentityHash()),watchDescriptor(-1){
+		State ps{std::allocator<char>()};
+		ps.recording=&recording;
+		parser.prepareParse();
+		parser.parseArgsFromFile(ps,this->path);
+		parser.concludeParse(ps);
+		finishParse(ps);
+#ifdef CL_OPTIONS_INOTIFY
+		watchDescriptor=inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+		updateWatches();
+#endif
+	}
+	ConfigWatcher(const ConfigWatcher&)=delete;
+	ConfigWatcher& operator=(const ConfigWatcher&)=delete;
+	~ConfigWatcher(){
+#ifdef CL_OPTIONS_INOTIFY
+		if(watchDescriptor>=0)
+			close(watchDescriptor);
+#endif
+	}
+	
+	///A file descriptor which becomes readable when a watched file may have 
+	///changed, or -1 if changes cannot be detected this way
+	int fileDescriptor() const{ return(watchDescriptor); }
+	
+	///The positional arguments found by the last successful parse
+	const std::vector<std::string>& positionals() const{ return(currentPositionals); }
+	
+	///The paths of all configuration files read by the last successful parse
+	const std::vector<std::string>& files() const{ return(recording.files); }
+	
+	///Check whether any watched file has changed, and if so parse the 
+	///configuration again and apply any options whose values changed. 
+	///This does not block. 
+	ReloadResult poll(){
+#ifdef CL_OPTIONS_INOTIFY
+		if(watchDescriptor>=0 && !consumeEvents())
+			return(ReloadResult{false,{},std::string()});
+#endif
+		return(reload());
+	}
+	
+	///Parse the configuration again, whether or not it appears to have 
+	///changed, and apply any options whose values changed
+	ReloadResult reload(){
+		ReloadResult result{false,{},std::string()};
+		OptionParser::ParseRecording next(false);
+		State ps{std::allocator<char>()};
+		ps.recording=&next;
+		ps.fileCache.swap(cache);
+		try{
+			parser.prepareParse();
+			parser.parseArgsFromFile(ps,path);
+		}catch(std::runtime_error& err){
+			ps.fileCache.swap(cache);
+			result.error=err.what();
+			return(result);
+		}
+		try{
+			parser.applyChanges(recording,next,result.changedOptions);
+		}catch(std::runtime_error& err){
+			//keep the previous configuration, so that every change is 
+			//attempted again by the next reload
+			ps.fileCache.swap(cache);
+			result.error=err.what();
+			return(result);
+		}
+		result.reloaded=true;
+		recording=std::move(next);
+		finishParse(ps);
+#ifdef CL_OPTIONS_INOTIFY
+		updateWatches();
+#endif
+		return(result);
+	}
+	
+private:
+	using State=OptionParser::ParsingState<std::allocator<char>>;
+	
+	///Keep the results of a successful parse, and the tokens of the files it 
+	///used
+	void finishParse(State& ps){
+		for(auto it=ps.fileCache.begin(); it!=ps.fileCache.end(); ){
+			if(recording.fileIdentities.count(it->first))
+				++it;
+			else
+				it=ps.fileCache.erase(it);
+		}
+		cache.swap(ps.fileCache);
+		currentPositionals=std::move(ps.positionals);
+	}
+	
+#ifdef CL_OPTIONS_INOTIFY
+	///The files of interest within a watched directory
+	struct WatchedDirectory{
+		///whether all files are of interest, as for a configuration directory
+		bool allFiles;
+		std::unordered_set<std::string> names;
+	};
+	
+	///Watch the directories containing all files used by the last parse
+	void updateWatches(){
+		if(watchDescriptor<0)
+			return;
+		for(auto& watch : watches){
+			watch.second.allFiles=false;
+			watch.second.names.clear();
+		}
+		const uint32_t mask=IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_CREATE
+		                    |IN_DELETE|IN_ATTRIB|IN_DELETE_SELF|IN_MOVE_SELF;
+		//files are watched through their directories, so that files which are
+		//replaced by renaming are still noticed
+		for(const std::string& file : recording.files){
+			size_t slash=file.rfind('/');
+			std::string directory=(slash==std::string::npos ? "." : file.substr(0,slash+1));
+			int watch=inotify_add_watch(watchDescriptor,directory.c_str(),mask);
+			if(watch>=0)
+				watches[watch].names.insert(file.substr(slash==std::string::npos?0:slash+1));
+		}
+		for(const std::string& directory : recording.directories){
+			int watch=inotify_add_watch(watchDescriptor,directory.c_str(),mask);
+			if(watch>=0)
+				watches[watch].allFiles=true;
+		}
+	}
+	
+	///Read all pending change notifications
+	///\return whether any of them concern files of interest
+	bool consumeEvents(){
+		bool relevant=false;
+		alignas(inotify_event) char buffer[4096];
+		while(true){
+			ssize_t length=read(watchDescriptor,buffer,sizeof(buffer));
+			if(length<=0)
+				break;
+			for(char* pos=buffer; pos<buffer+length; ){
+				const inotify_event* event=reinterpret_cast<const inotify_event*>(pos);
+				pos+=sizeof(inotify_event)+event->len;
+				if(event->mask&(IN_Q_OVERFLOW|IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF)){
+					relevant=true;
+					if(event->mask&IN_IGNORED)
+						watches.erase(event->wd);
+					continue;
+				}
+				auto watch=watches.find(event->wd);
+				if(watch==watches.end())
+					continue;
+				if(watch->second.allFiles || (event->len && watch->second.names.count(event->name)))
+					relevant=true;
+			}
+		}
+		return(relevant);
+	}
+	
+	std::unordered_map<int,WatchedDirectory> watches;
+#endif
+	
+	OptionParser& parser;
+	std::string path;
+	///the options used and files read by the last successful parse
+	OptionParser::ParseRecording recording;
+	///the tokens of the files read by the last successful parse
+	State::CacheMap cache;
+	std::vector<std::string> currentPositionals;
+	int watchDescriptor;
+};
+
+///A single option in a schema for StaticOptionParser. Options are created by 
+///the static factory functions, and store their results in members of an 
+///object of type Target. 
+///
+/// A name of a single character makes a short option, while a longer name 
+/// makes a long option. 
+template<typename Target>
+struct StaticOption{
+	///the name of the option
+	const char* name;
+	///the description of the option
+	const char* description;
+	///the name used to document the value, or null if no value is taken
+	const char* valueName;
+	///the function which applies the option (and its value, if any) to the target
+	///\return false if the value could not be parsed
+	bool (*apply)(Target&, OptionParser::StringView);
+	
+	///Make an option which sets a boolean member to true
+	///\param name the name of the option
+	///\param description the description of the option
+	template<bool Target::*Member>
+	static constexpr StaticOption flag(const char* name, const char* description){
+		return(StaticOption{name,description,nullptr,&setFlag<Member>});
+	}
+	///Make an option which invokes a function without taking a value
+	///\param name the name of the option
+	///\param description the description of the option
+	template<void (*Action)(Target&)>
+	static constexpr StaticOption action(const char* name, const char* description){
+		return(StaticOption{name,description,nullptr,&callAction<Action>});
+	}
+	///Make an option which stores a value to a member
+	///\param name the name of the option
+	///\param description the description of the option
+	///\param valueName the name used to document the value
+	template<typename T, T Target::*Member>
+	static constexpr StaticOption value(const char* name, const char* description, const char* valueName="value"){
+		return(StaticOption{name,description,valueName,&storeValue<T,Member>});
+	}
+	
+private:
+	template<bool Target::*Member>
+	static bool setFlag(Target& target, OptionParser::StringView){
+		target.*Member=true;
+		return(true);
+	}
+	template<void (*Action)(Target&)>
+	static bool callAction(Target& target, OptionParser::StringView){
+		Action(target);
+		return(true);
+	}
+	template<typename T, T Target::*Member>
+	static bool storeValue(Target& target, OptionParser::StringView optData){
+		return(OptionValueConverter<T>::convert(optData.begin(),optData.end(),target.*Member));
+	}
+};
+
+namespace cl_options_detail{
+	template<size_t... I>
+	struct Indices{};
+	
+	template<typename A, typename B>
+	struct ConcatIndices;
+	template<size_t... A, size_t... B>
+	struct ConcatIndices<Indices<A...>,Indices<B...>>{
+		using type=Indices<A...,(sizeof...(A)+B)...>;
+	};
+	
+	///Produces Indices<0,...,N-1>, with recursion depth logarithmic in N
+	template<size_t N>
+	struct MakeIndices{
+		using type=typename ConcatIndices<typename MakeIndices<N/2>::type,
+		                                  typename MakeIndices<N-N/2>::type>::type;
+	};
+	template<>
+	struct MakeIndices<0>{ using type=Indices<>; };
+	template<>
+	struct MakeIndices<1>{ using type=Indices<0>; };
+	
+	///FNV-1a
+	constexpr uint32_t hashName(const char* s, uint32_t h=2166136261u){
+		return(*s ? hashName(s+1,(h^(unsigned char)*s)*16777619u) : h);
+	}
+	///FNV-1a
+	inline uint32_t hashName(const char* s, size_t len){
+		uint32_t h=2166136261u;
+		for(const char* end=s+len; s!=end; s++)
+			h=(h^(unsigned char)*s)*16777619u;
+		return(h);
+	}
+	
+	///Compile-time queries on the options in a schema for StaticOptionParser. 
+	///Functions operating on ranges split them in half, so that recursion 
+	///depth stays logarithmic in the number of options and within compilers' 
+	///constexpr limits. 
+	template<typename Schema>
+	struct SchemaInfo{
+		static constexpr size_t size=sizeof(Schema::options)/sizeof(Schema::options[0]);
+		
+		static constexpr size_t roundUpToPowerOfTwo(size_t n, size_t p=1){
+			return(p>=n ? p : roundUpToPowerOfTwo(n,2*p));
+		}
+		///the size of the sorting network
+		static constexpr size_t paddedSize=roundUpToPowerOfTwo(size<2 ? 2 : size);
+		
+		static constexpr bool sameName(const char* a, const char* b){
+			return(*a==*b && (*a=='\0' || sameName(a+1,b+1)));
+		}
+		static constexpr bool contains(const char* s, char c){
+			return(*s && (*s==c || contains(s+1,c)));
+		}
+		static constexpr bool validName(const char* s){
+			return(*s!='\0' && *s!='-' && !contains(s,'='));
+		}
+		///whether all options in [lo,hi) have valid names
+		static constexpr bool validNames(size_t lo, size_t hi){
+			return(hi-lo==0 ? true :
+			       hi-lo==1 ? validName(Schema::options[lo].name) :
+			       validNames(lo,lo+(hi-lo)/2) && validNames(lo+(hi-lo)/2,hi));
+		}
+		static constexpr bool isShort(size_t i){
+			return(Schema::options[i].name[0]!='\0' && Schema::options[i].name[1]=='\0');
+		}
+		///The key by which options are sorted for lookup: long options are 
+		///ordered by the hashes of their names, and followed by short options 
+		///ordered by character. The low 16 bits hold the index of the option, and 
+		///padding entries have the largest possible key. 
+		static constexpr uint64_t sortKey(size_t i){
+			return(i>=size ? ~(uint64_t)0 :
+			       isShort(i) ? ((uint64_t)1<<63) | ((uint64_t)(unsigned char)Schema::options[i].name[0]<<16) | i :
+			       ((uint64_t)hashName(Schema::options[i].name)<<16) | i);
+		}
+	};
+	
+	///One stage of a bitonic sorting network over the sort keys of a schema, 
+	///which compares and exchanges elements at distance J within blocks of size
+	///K. Stage <1,0> holds the unsorted keys. 
+	template<typename Schema, size_t K, size_t J, typename PaddedIndices>
+	struct SortStage;
+	
+	template<typename Schema, size_t K, size_t J>
+	struct SortStageInputs{
+		//the stage preceding (K,J) is (K,2J) within a block size, or else the 
+		//last stage, (K/2,1), of the previous block size
+		using Prev=typename std::conditional<(2*J<K),
+		  SortStage<Schema,K,2*J,typename MakeIndices<SchemaInfo<Schema>::paddedSize>::type>,
+		  SortStage<Schema,(K>2?K/2:1),(K>2?1:0),typename MakeIndices<SchemaInfo<Schema>::paddedSize>::type>>::type;
+		static constexpr uint64_t exchange(size_t i, uint64_t a, uint64_t b){
+			return(((i&K)==0)==(i<(i^J)) ? (a<b?a:b) : (a<b?b:a));
+		}
+		static constexpr uint64_t at(size_t i){
+			return(exchange(i,Prev::keys[i],Prev::keys[i^J]));
+		}
+	};
+	
+	template<typename Schema, size_t K, size_t J, size_t... I>
+	struct SortStage<Schema,K,J,Indices<I...>>{
+		static constexpr uint64_t keys[sizeof...(I)]={SortStageInputs<Schema,K,J>::at(I)...};
+	};
+	template<typename Schema, size_t... I>
+	struct SortStage<Schema,1,0,Indices<I...>>{
+		static constexpr uint64_t keys[sizeof...(I)]={SchemaInfo<Schema>::sortKey(I)...};
+	};
+	template<typename Schema, size_t K, size_t J, size_t... I>
+	constexpr uint64_t SortStage<Schema,K,J,Indices<I...>>::keys[sizeof...(I)];
+	template<typename Schema, size_t... I>
+	constexpr uint64_t SortStage<Schema,1,0,Indices<I...>>::keys[sizeof...(I)];
+	
+	///Lookup tables derived from the sorted keys of a schema
+	template<typename Schema>
+	struct SchemaOrder{
+		using Info=SchemaInfo<Schema>;
+		using Sorted=SortStage<Schema,Info::paddedSize,1,typename MakeIndices<Info::paddedSize>::type>;
+		
+		static constexpr uint64_t keyAt(size_t r){
+			return(Sorted::keys[r]);
+		}
+		///the option at sorted position r
+		static constexpr size_t optionAt(size_t r){
+			return(keyAt(r)&0xFFFF);
+		}
+		///the first position in [lo,hi) whose key is not less than key
+		static constexpr size_t lowerBound(uint64_t key, size_t lo, size_t hi){
+			return(hi-lo==0 ? lo :
+			       keyAt(lo+(hi-lo)/2)<key ? lowerBound(key,lo+(hi-lo)/2+1,hi) : lowerBound(key,lo,lo+(hi-lo)/2));
+		}
+		///the number of long options, which come first in sorted order
+		static constexpr size_t longCount(){
+			return(lowerBound((uint64_t)1<<63,0,Info::size));
+		}
+		///the index of the short option named c, or -1
+		static constexpr int findShort(size_t c){
+			return(shortAt(lowerBound(((uint64_t)1<<63)|((uint64_t)c<<16),0,Info::size),c));
+		}
+		static constexpr int shortAt(size_t r, size_t c){
+			return(r<Info::size && (keyAt(r)>>16)==(((uint64_t)1<<47)|c) ? (int)optionAt(r) : -1);
+		}
+		///whether the option at sorted position r shares its name with any option
+		///from position s onwards in the run of positions with the same name key
+		static constexpr bool duplicateAfter(size_t r, size_t s){
+			return(s<Info::size && (keyAt(s)>>16)==(keyAt(r)>>16) && 
+			       (Info::sameName(Schema::options[optionAt(r)].name,Schema::options[optionAt(s)].name) 
+			        || duplicateAfter(r,s+1)));
+		}
+		///whether any option at a sorted position in [lo,hi) shares its name 
+		///with a later one. Equal names have equal keys, but different names 
+		///whose hashes collide may sort between them, so each whole run of 
+		///equal keys is compared. 
+		static constexpr bool duplicateNames(size_t lo, size_t hi){
+			return(hi-lo==0 ? false :
+			       hi-lo==1 ? duplicateAfter(lo,lo+1) :
+			       duplicateNames(lo,lo+(hi-lo)/2) || duplicateNames(lo+(hi-lo)/2,hi));
+		}
+	};
+}
+
+///A parser for a fixed set of options declared at compile time. 
+///
+/// The schema is a class which names the type into which options are stored 
+/// and declares the options as a constexpr array:
+/// \code
+/// struct Settings{ bool verbose=false; int threads=1; };
+/// struct SettingsSchema{
+///     using Target=Settings;
+///     static constexpr StaticOption<Settings> options[]={
+///         StaticOption<Settings>::flag<&Settings::verbose>("v","Print more output"),
+///         StaticOption<Settings>::value<int,&Settings::threads>("threads","Number of threads","n"),
+///     };
+/// };
+/// Settings settings;
+/// auto positionals=StaticOptionParser<SettingsSchema>().parseArgs(settings,argc,argv);
+/// \endcode
+/// All lookup tables are computed during compilation: short options are 
+/// dispatched through a table indexed by character, and long options through a 
+/// sorted table of name hashes. Constructing a parser therefore does no work, 
+/// and nothing is allocated for handlers. Invalid or duplicate option names 
+/// cause compilation to fail. Options otherwise behave as they do for 
+/// OptionParser, except that configuration file options are not supported. 
+template<typename Schema, 
+         typename OptionIndices=typename cl_options_detail::MakeIndices<cl_options_detail::SchemaInfo<Schema>::size>::type,
+         typename CharIndices=typename cl_options_detail::MakeIndices<256>::type>
+class StaticOptionParser;
+
+template<typename Schema, size_t... I, size_t... C>
+class StaticOptionParser<Schema,cl_options_detail::Indices<I...>,cl_options_detail::Indices<C...>>{
+public:
+	using Target=typename Schema::Target;
+private:
+	using Info=cl_options_detail::SchemaInfo<Schema>;
+	using Order=cl_options_detail::SchemaOrder<Schema>;
+	
+	static_assert(Info::size>0, "A schema must contain at least one option");
+	static_assert(Info::size<=0xFFFF, "A schema may contain at most 65535 options");
+	static_assert(Info::validNames(0,Info::size), "Option names may not be empty, begin with '-', or contain '='");
+	static_assert(!Order::duplicateNames(0,Info::size), "Option names must be unique");
+	
+	//copies of the schema, so that it need not be defined outside its class
+	static constexpr const char* names[Info::size]={Schema::options[I].name...};
+	static constexpr const char* descriptions[Info::size]={Schema::options[I].description...};
+	static constexpr const char* valueNames[Info::size]={Schema::options[I].valueName...};
+	static constexpr bool (*applies[Info::size])(Target&, OptionParser::StringView)={Schema::options[I].apply...};
+	///short options, indexed by character, or -1 where no option is defined
+	static constexpr int16_t shortSlots[256]={(int16_t)Order::findShort(C)...};
+	///the number of long options
+	static constexpr size_t longCount=Order::longCount();
+	///the long options, in order of the hashes of their names
+	static constexpr uint16_t sortedOptions[Info::size]={(uint16_t)Order::optionAt(I)...};
+	///the hashes of the names of sortedOptions
+	static constexpr uint32_t sortedHashes[Info::size]={(uint32_t)(Order::keyAt(I)>>16)...};
+	
+	///Whether a short option taking a value may be directly followed by its 
+	///value without a separating equals sign
+	bool allowShortValueWithoutEquals;
+	///Whether multiple short options may be run together
+	bool allowShortOptionCombination;
+	///Whether the special option '--' ends option parsing
+	bool allowOptionTerminator;
+	
+	///Look up a long option
+	///\return the index of the option, or -1 if there is no such option
+	static int findLong(const char* name, size_t len){
+		uint32_t h=cl_options_detail::hashName(name,len);
+		const uint32_t* it=std::lower_bound(sortedHashes,sortedHashes+longCount,h);
+		for(; it!=sortedHashes+longCount && *it==h; it++){
+			uint16_t opt=sortedOptions[it-sortedHashes];
+			if(std::char_traits<char>::length(names[opt])==len && 
+			   std::char_traits<char>::compare(names[opt],name,len)==0)
+				return(opt);
+		}
+		return(-1);
+	}
+	
+	static void apply(Target& target, size_t opt, OptionParser::StringView value){
+		if(!applies[opt](target,value))
+			throw std::runtime_error("Failed to parse \""+value.str()+"\" as argument to '"
+			                         +std::string(names[opt])+"' option");
+	}
+	
+public:
+	constexpr StaticOptionParser():allowShortValueWithoutEquals(false),
+	allowShortOptionCombination(false),allowOptionTerminator(false){}
+	
+	///Whether a short option taking a value may be directly followed by its 
+	///value without a separating equals sign
+	bool allowsShortValueWithoutEquals() const{ return(allowShortValueWithoutEquals); }
+	///Set whether a short option taking a value may be directly followed by its 
+	///value without a separating equals sign
+	void allowsShortValueWithoutEquals(bool allow){ allowShortValueWithoutEquals=allow; }
+	///Whether multiple short options may be written together in a single 
+	///argument
+	bool allowsShortOptionCombination() const{ return(allowShortOptionCombination); }
+	///Set whether multiple short options may be written together in a single 
+	///argument
+	void allowsShortOptionCombination(bool allow){ allowShortOptionCombination=allow; }
+	///Whether the special option '--' ends option parsing
+	bool allowsOptionTerminator() const{ return(allowOptionTerminator); }
+	///Set whether the special option '--' ends option parsing
+	void allowsOptionTerminator(bool allow){ allowOptionTerminator=allow; }
+	
+	///Get the usage message, summarizing all options in the schema
+	std::string getUsage() const{
+		std::string usage;
+		for(size_t i=0; i<Info::size; i++){
+			usage+=(names[i][1] ? " --" : " -");
+			usage+=names[i];
+			if(valueNames[i]){
+				usage+=' ';
+				usage+=valueNames[i];
+			}
+			usage+=": ";
+			usage+=descriptions[i];
+			usage+='\n';
+		}
+		return(usage);
+	}
+	
+	///Parse a collection of arguments
+	///\param target the object to which options will be applied
+	///\param argBegin an iterator referencing the first argument
+	///\param argEnd an iterator referencing the point after all arguments
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	template<typename Iterator>
+	std::vector<std::string> parseArgs(Target& target, Iterator argBegin, Iterator argEnd) const{
+		static const auto& npos=std::string::npos;
+		std::vector<std::string> positionals;
+		for(; argBegin!=argEnd; ++argBegin){
+			//binding the token keeps it alive for this iteration even if the 
+			//iterator returns it by value
+			auto&& token=*argBegin;
+			OptionParser::StringView arg=token;
+			if(arg.size()<2 || arg[0]!='-'){
+				positionals.emplace_back(arg.begin(),arg.end());
+				continue;
+			}
+			if(allowOptionTerminator && arg.size()==2 && arg[1]=='-'){
+				for(++argBegin; argBegin!=argEnd; ++argBegin){
+					auto&& positional=*argBegin;
+					OptionParser::StringView view=positional;
+					positionals.emplace_back(view.begin(),view.end());
+				}
+				break;
+			}
+			size_t startIdx=arg.find_first_not_of('-');
+			if(startIdx>2){
+				positionals.emplace_back(arg.begin(),arg.end());
+				continue;
+			}
+			int opt;
+			size_t endIdx, valueOffset=1;
+			if(startIdx==1){
+				//a short option, or a group of them
+				while(true){
+					if(allowShortValueWithoutEquals || allowShortOptionCombination){
+						endIdx=startIdx+1;
+						valueOffset=0;
+						if(endIdx==arg.size())
+							endIdx=npos;
+						else if(arg[endIdx]=='=')
+							valueOffset=1;
+					}
+					else
+						endIdx=arg.find('=',startIdx);
+					size_t optLen=(endIdx==npos?arg.size():endIdx)-startIdx;
+					if(optLen==0)
+						throw std::runtime_error("Invalid option: '"+arg.str()+"'");
+					if(optLen>1)
+						throw std::runtime_error("Malformed option: '"+arg.str()+"' (wrong number of leading dashes)");
+					opt=shortSlots[(unsigned char)arg[startIdx]];
+					if(opt<0)
+						throw std::runtime_error("Unknown option: '"+arg.substr(startIdx,1).str()+"' in '"+arg.str()+"'");
+					if(valueNames[opt] || endIdx==npos)
+						break;
+					if(!allowShortOptionCombination)
+						throw std::runtime_error("Malformed option: '"+arg.str()+"' (no value expected for this flag)");
+					apply(target,opt,OptionParser::StringView());
+					startIdx++;
+				}
+			}
+			else{
+				endIdx=arg.find('=',startIdx);
+				size_t optLen=(endIdx==npos?arg.size():endIdx)-startIdx;
+				if(optLen==0)
+					throw std::runtime_error("Invalid option: '"+arg.str()+"'");
+				if(optLen==1)
+					throw std::runtime_error("Malformed option: '"+arg.str()+"' (wrong number of leading dashes)");
+				opt=findLong(arg.data()+startIdx,optLen);
+				if(opt<0)
+					throw std::runtime_error("Unknown option: '"+arg.str()+"'");
+				if(!valueNames[opt] && endIdx!=npos)
+					throw std::runtime_error("Malformed option: '"+arg.str()+"' (no value expected for this flag)");
+			}
+			if(!valueNames[opt])
+				apply(target,opt,OptionParser::StringView());
+			else if(endIdx!=npos)
+				apply(target,opt,arg.substr(endIdx+valueOffset));
+			else{
+				++argBegin;
+				if(argBegin==argEnd)
+					throw std::runtime_error("Missing value for '"+arg.str()+"'");
+				apply(target,opt,*argBegin);
+			}
+		}
+		return(positionals);
+	}
+	///Parse a collection of arguments
+	///\param target the object to which options will be applied
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	std::vector<std::string> parseArgs(Target& target, int argc, char* argv[]) const{
+		return(parseArgs(target,argv,argv+argc));
+	}
+	///Parse a collection of arguments
+	///\param target the object to which options will be applied
+	///\param argc the number of arguments
+	///\param argv the array of arguments
+	///\return the positional arguments in the order they were encountered in 
+	///        the input
+	std::vector<std::string> parseArgs(Target& target, int argc, const char* argv[]) const{
+		return(parseArgs(target,argv,argv+argc));
+	}
+};
+
+#define CL_OPTIONS_STATIC_PARSER_TABLE(type,name,dims) \
+template<typename Schema, size_t... I, size_t... C> \
+constexpr type StaticOptionParser<Schema,cl_options_detail::Indices<I...>,cl_options_detail::Indices<C...>>::name dims;
+CL_OPTIONS_STATIC_PARSER_TABLE(const char*,names,[cl_options_detail::SchemaInfo<Schema>::size])
+CL_OPTIONS_STATIC_PARSER_TABLE(const char*,descriptions,[cl_options_detail::SchemaInfo<Schema>::size])
+CL_OPTIONS_STATIC_PARSER_TABLE(const char*,valueNames,[cl_options_detail::SchemaInfo<Schema>::size])
+CL_OPTIONS_STATIC_PARSER_TABLE(int16_t,shortSlots,[256])
+CL_OPTIONS_STATIC_PARSER_TABLE(uint16_t,sortedOptions,[cl_options_detail::SchemaInfo<Schema>::size])
+CL_OPTIONS_STATIC_PARSER_TABLE(uint32_t,sortedHashes,[cl_options_detail::SchemaInfo<Schema>::size])
+#undef CL_OPTIONS_STATIC_PARSER_TABLE
+template<typename Schema, size_t... I, size_t... C>
+constexpr bool (*StaticOptionParser<Schema,cl_options_detail::Indices<I...>,cl_options_detail::Indices<C...>>::applies[cl_options_detail::SchemaInfo<Schema>::size])
+  (typename Schema::Target&, OptionParser::StringView);
+
 #endif //CL_OPTIONS_H
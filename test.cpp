@@ -1,5 +1,8 @@
 #include <iostream>
+#include <thread>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "cl_options.h"
 
 //Launder access to private class members for testing
@@ -7,6 +10,9 @@ class cl_options_test_access{
 public:
 	template<typename C>
 	using TokenIterator=OptionParser::TokenIterator<C>;
+	using OptionHandler=OptionParser::OptionHandler;
+	using FileContents=OptionParser::FileContents;
+	static size_t handlerCount(const OptionParser& op){ return(op.options.size()); }
 };
 
 void require(bool cond, const char* cond_s, unsigned int line){
@@ -361,6 +367,40 @@ void test_option_terminator(){
 	REQUIRE(positionals.back()=="-f");
 }
 
+///An input iterator which produces each argument as a new string
+struct ByValueIterator{
+	using iterator_category=std::input_iterator_tag;
+	using value_type=std::string;
+	using difference_type=std::ptrdiff_t;
+	using pointer=const std::string*;
+	using reference=std::string;
+	
+	const char* const* pos;
+	
+	std::string operator*() const{ return(std::string(*pos)+""); }
+	ByValueIterator& operator++(){ ++pos; return(*this); }
+	bool operator==(const ByValueIterator& other) const{ return(pos==other.pos); }
+	bool operator!=(const ByValueIterator& other) const{ return(pos!=other.pos); }
+};
+
+void test_by_value_iterator(){
+	bool fSet=false;
+	std::string name;
+	OptionParser op;
+	op.addOption('f',[&]{fSet=true;},"Set a flag");
+	op.addOption("name",name,"Set a name");
+	op.allowsOptionTerminator(true);
+	//long enough that the strings cannot be stored inline
+	const char* args[]={"--name","a name which is longer than a short string","-f",
+	                    "a positional which is longer than a short string","--","-f"};
+	std::vector<std::string> positionals=op.parseArgs(ByValueIterator{args},ByValueIterator{args+6});
+	REQUIRE(fSet);
+	REQUIRE(name=="a name which is longer than a short string");
+	REQUIRE(positionals.size()==2);
+	REQUIRE(positionals[0]=="a positional which is longer than a short string");
+	REQUIRE(positionals[1]=="-f");
+}
+
 void test_token_iterator(){
 	std::string rawInput=R"(foo "bar baz" quux\ xen
 	'"hom" \drel')";
@@ -385,6 +425,67 @@ void test_token_iterator(){
 	REQUIRE(*it=="\"hom\" \\drel");
 }
 
+//tokenize text both from a stream and from contiguous memory
+template<typename Callback>
+void tokenizeBothWays(const std::string& text, Callback check){
+	std::istringstream iss(text);
+	using CharIterator=std::istreambuf_iterator<char>;
+	using StreamIterator=cl_options_test_access::TokenIterator<CharIterator>;
+	CharIterator cit(iss), cend;
+	std::vector<std::string> fromStream(StreamIterator(cit,cend),StreamIterator(cend,cend));
+	using MemoryIterator=cl_options_test_access::TokenIterator<const char*>;
+	const char* begin=text.data(), *end=text.data()+text.size();
+	std::vector<std::string> fromMemory(MemoryIterator(begin,end),MemoryIterator(end,end));
+	check(fromStream,fromMemory);
+}
+
+void test_contiguous_token_iterator(){
+	tokenizeBothWays("  a_rather_long_unquoted_token 'a long simply-quoted \\ token'\t\"a \\\"long\\\" complex token\"\n\n",
+	  [](const std::vector<std::string>& fromStream, const std::vector<std::string>& fromMemory){
+		REQUIRE(fromStream==fromMemory);
+		REQUIRE(fromMemory.size()==3);
+		REQUIRE(fromMemory[0]=="a_rather_long_unquoted_token");
+		REQUIRE(fromMemory[1]=="a long simply-quoted \\ token");
+		REQUIRE(fromMemory[2]=="a \"long\" complex token");
+	});
+	//the two must agree on arbitrary input
+	const char alphabet[]="abcdefghijklmnop \t\n\v\r'\"\\\xe9";
+	unsigned int state=12345;
+	for(unsigned int trial=0; trial<500; trial++){
+		std::string text;
+		for(unsigned int i=0; i<200; i++){
+			state=state*1103515245u+12345u;
+			unsigned int r=(state>>16)%64;
+			//favor long runs of ordinary characters
+			text+=(r<sizeof(alphabet)-1 ? alphabet[r] : 'x');
+		}
+		tokenizeBothWays(text,[&](const std::vector<std::string>& fromStream, const std::vector<std::string>& fromMemory){
+			REQUIRE(fromStream==fromMemory);
+			//only quotes at the very end can form an empty token
+			for(size_t i=0; i+1<fromMemory.size(); i++)
+				REQUIRE(!fromMemory[i].empty());
+		});
+	}
+}
+
+void test_empty_quoted_tokens(){
+	for(const char* text : {"a ''","a \"\" ","a ''\n\n"}){
+		tokenizeBothWays(text,[](const std::vector<std::string>& fromStream, const std::vector<std::string>& fromMemory){
+			REQUIRE(fromStream==fromMemory);
+			REQUIRE(fromMemory.size()==2);
+			REQUIRE(fromMemory[0]=="a" && fromMemory[1].empty());
+		});
+	}
+	//trailing whitespace alone does not form a token
+	tokenizeBothWays("a \n\t",[](const std::vector<std::string>& fromStream, const std::vector<std::string>& fromMemory){
+		REQUIRE(fromStream==fromMemory);
+		REQUIRE(fromMemory.size()==1);
+	});
+	OptionParser op;
+	std::istringstream ss("a ''");
+	REQUIRE(op.parseArgsFromStream(ss).size()==2);
+}
+
 void test_positionals_and_options_from_stream(){
 	bool fSet=false;
 	int number=0;
@@ -490,6 +591,1428 @@ void test_config_file_parsing_loop(){
 	unlink(".test_c2");
 }
 
+void test_config_file_parsing_symlink_loop(){
+	OptionParser op;
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-c .test_c2";
+	}
+	REQUIRE(symlink(".test_c1",".test_c2")==0);
+	try{
+		op.parseArgsFromFile(".test_c1");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("Configuration file loop")!=std::string::npos);
+	}
+	unlink(".test_c1");
+	unlink(".test_c2");
+}
+
+void test_config_file_repeated_include(){
+	int number=0;
+	std::vector<std::string> names;
+	OptionParser op;
+	op.addOption('n',number,"Set a number");
+	op.addOption("name",std::function<void(std::string)>([&](std::string n){ names.push_back(n); }),"Add a name");
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-c .test_c2 -n 1 -c ./.test_c2 -n 2 -c .test_c2";
+		std::ofstream o2(".test_c2");
+		o2 << "--name 'a fairly long name' positional";
+	}
+	std::vector<std::string> positionals=op.parseArgsFromFile(".test_c1");
+	unlink(".test_c1");
+	unlink(".test_c2");
+	REQUIRE(number==2);
+	REQUIRE(names.size()==3);
+	REQUIRE(names[2]=="a fairly long name");
+	REQUIRE(positionals.size()==3);
+	REQUIRE(positionals[2]=="positional");
+}
+
+void test_config_file_snapshot(){
+	int number=0;
+	bool fSet=false;
+	OptionParser op;
+	op.addOption('n',number,"Set a number");
+	op.addOption('f',[&]{fSet=true;},"Set a flag");
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-f 'first positional' -c .test_c2 -c .test_c2";
+		std::ofstream o2(".test_c2");
+		o2 << "-n 1 second";
+	}
+	std::vector<std::string> positionals=op.parseArgsFromFileWithSnapshot(".test_c1",".test_snap");
+	REQUIRE(positionals.size()==3 && positionals[0]=="first positional" && positionals[2]=="second");
+	REQUIRE(number==1 && fSet);
+	std::ifstream snapshot(".test_snap");
+	REQUIRE(snapshot.good());
+	
+	//change the contents of a file without changing its size or modification
+	//time, so that the snapshot will still be used, proving that it is
+	struct stat info;
+	REQUIRE(stat(".test_c2",&info)==0);
+	{
+		std::ofstream o2(".test_c2");
+		o2 << "-n 2 second";
+	}
+	struct timespec times[2]={info.st_atim,info.st_mtim};
+	REQUIRE(utimensat(AT_FDCWD,".test_c2",times,0)==0);
+	number=0;
+	fSet=false;
+	positionals=op.parseArgsFromFileWithSnapshot(".test_c1",".test_snap");
+	REQUIRE(positionals.size()==3 && positionals[1]=="second");
+	REQUIRE(number==1 && fSet);
+	
+	//a change to the size invalidates the snapshot
+	{
+		std::ofstream o2(".test_c2");
+		o2 << "-n 22 second";
+	}
+	REQUIRE(utimensat(AT_FDCWD,".test_c2",times,0)==0);
+	positionals=op.parseArgsFromFileWithSnapshot(".test_c1",".test_snap");
+	REQUIRE(number==22);
+	//and the rewritten snapshot reflects the change
+	positionals=op.parseArgsFromFileWithSnapshot(".test_c1",".test_snap");
+	REQUIRE(number==22);
+	REQUIRE(positionals.size()==3);
+	
+	//so are snapshots whose recorded sizes are impossible, even though the 
+	//files they describe are unchanged
+	std::string valid;
+	{
+		std::ifstream in(".test_snap",std::ios::binary);
+		valid.assign(std::istreambuf_iterator<char>(in),std::istreambuf_iterator<char>());
+	}
+	//the file size and text size of .test_c2, followed by its token count
+	const uint64_t sizes[2]={12,10};
+	const uint32_t tokenCount=3;
+	std::string recordedSizes(reinterpret_cast<const char*>(sizes),sizeof(sizes));
+	recordedSizes.append(reinterpret_cast<const char*>(&tokenCount),sizeof(tokenCount));
+	size_t sizesOffset=valid.find(recordedSizes);
+	REQUIRE(sizesOffset!=std::string::npos);
+	for(size_t field : {sizesOffset+8, sizesOffset+16}){
+		std::string corrupt=valid;
+		const uint64_t huge=~uint64_t(0)>>2;
+		std::memcpy(&corrupt[field],&huge,(field==sizesOffset+8 ? 8 : 4));
+		{
+			std::ofstream o3(".test_snap",std::ios::binary|std::ios::trunc);
+			o3 << corrupt;
+		}
+		number=0;
+		positionals=op.parseArgsFromFileWithSnapshot(".test_c1",".test_snap");
+		REQUIRE(number==22);
+		REQUIRE(positionals.size()==3);
+	}
+	
+	//a corrupt snapshot is ignored
+	{
+		std::ofstream o3(".test_snap");
+		o3 << "CLOPTSNP garbage";
+	}
+	number=0;
+	positionals=op.parseArgsFromFileWithSnapshot(".test_c1",".test_snap");
+	REQUIRE(number==22);
+	REQUIRE(positionals.size()==3);
+	unlink(".test_c1");
+	unlink(".test_c2");
+	unlink(".test_snap");
+}
+
+void test_config_directory(){
+	std::vector<std::string> names;
+	OptionParser op;
+	op.addOption("name",std::function<void(std::string)>([&](std::string n){ names.push_back(n); }),"Add a name");
+	op.addConfigFileOption('c',"Read config from a file or directory");
+	REQUIRE(mkdir(".test_d",0755)==0);
+	REQUIRE(mkdir(".test_d/subdir.conf",0755)==0);
+	//write the files in an order different from that in which they should be read
+	for(unsigned int i=40; i>0; i--){
+		std::ofstream out(".test_d/"+std::string(i<10?"0":"")+std::to_string(i)+".conf");
+		out << "--name " << i << " positional" << i;
+	}
+	{
+		std::ofstream ignored(".test_d/ignored.txt");
+		ignored << "--name ignored";
+		std::ofstream hidden(".test_d/.hidden.conf");
+		hidden << "--name hidden";
+		std::ofstream o1(".test_c1");
+		o1 << "-c .test_d --name last";
+	}
+	std::vector<std::string> positionals=op.parseArgsFromFile(".test_c1");
+	REQUIRE(names.size()==41);
+	REQUIRE(positionals.size()==40);
+	for(unsigned int i=1; i<=40; i++){
+		REQUIRE(names[i-1]==std::to_string(i));
+		REQUIRE(positionals[i-1]=="positional"+std::to_string(i));
+	}
+	REQUIRE(names[40]=="last");
+	
+	//changing the suffix selects different files
+	names.clear();
+	op.configDirectorySuffix(".txt");
+	op.parseArgsFromFile(".test_d");
+	REQUIRE(names.size()==1 && names[0]=="ignored");
+	
+	//a fragment including its own directory forms a loop
+	op.configDirectorySuffix(".conf");
+	{
+		std::ofstream out(".test_d/50.conf");
+		out << "-c .test_d/";
+	}
+	try{
+		op.parseArgsFromFile(".test_d");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		REQUIRE(std::string(ex.what()).find("Configuration file loop")!=std::string::npos);
+	}
+	
+	for(unsigned int i=1; i<=40; i++)
+		unlink((".test_d/"+std::string(i<10?"0":"")+std::to_string(i)+".conf").c_str());
+	unlink(".test_d/50.conf");
+	unlink(".test_d/ignored.txt");
+	unlink(".test_d/.hidden.conf");
+	rmdir(".test_d/subdir.conf");
+	rmdir(".test_d");
+	unlink(".test_c1");
+}
+
+void test_environment(){
+	int threads=1;
+	std::string outputFile;
+	bool dryRun=false, verbose=false;
+	OptionParser op;
+	op.addOption({"t","threads"},threads,"Number of threads");
+	op.addOption("output-file",outputFile,"Output file");
+	op.addOption("dry-run",[&]{dryRun=true;},"Do nothing");
+	op.addOption("verbose",[&]{verbose=true;},"Print more");
+	op.addConfigFileOption("config","Read config from a file");
+	
+	const char* env1[]={"PATH=/bin","MYTOOL_THREADS=4","MYTOOL_OUTPUT_FILE=out=1.txt",
+		"MYTOOL_DRY_RUN=","MYTOOL_VERBOSE=0","MYTOOL_UNKNOWN=x","MYTOOL_threads=8",
+		"OTHER_THREADS=16",nullptr};
+	auto positionals=op.parseEnvironment("MYTOOL_",env1);
+	REQUIRE(positionals.empty());
+	REQUIRE(threads==4);
+	REQUIRE(outputFile=="out=1.txt");
+	REQUIRE(dryRun && !verbose);
+	
+	const char* env2[]={"MYTOOL_VERBOSE=true","MYTOOL_THREADS=lots",nullptr};
+	try{
+		op.parseEnvironment("MYTOOL_",env2);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		REQUIRE(std::string(ex.what())=="Failed to parse \"lots\" as argument to 'threads' option");
+	}
+	REQUIRE(verbose);
+	
+	const char* env3[]={"MYTOOL_VERBOSE=yes",nullptr};
+	try{
+		op.parseEnvironment("MYTOOL_",env3);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		REQUIRE(std::string(ex.what())=="Failed to parse \"yes\" as the value of environment variable MYTOOL_VERBOSE (expected 1, 0, true, or false)");
+	}
+	
+	{
+		std::ofstream o(".test_env");
+		o << "--threads 6 extra";
+	}
+	const char* env4[]={"MYTOOL_CONFIG=.test_env",nullptr};
+	positionals=op.parseEnvironment("MYTOOL_",env4);
+	REQUIRE(threads==6);
+	REQUIRE(positionals.size()==1 && positionals[0]=="extra");
+	unlink(".test_env");
+	
+	//the automatic help option has no variable
+	const char* helpEnv[]={"MYTOOL_HELP=1","MYTOOL_USAGE=quota",nullptr};
+	std::ostringstream help;
+	std::streambuf* oldBuf=std::cout.rdbuf(help.rdbuf());
+	op.parseEnvironment("MYTOOL_",helpEnv);
+	std::cout.rdbuf(oldBuf);
+	REQUIRE(help.str().empty() && !op.didPrintUsage());
+	
+	//options added later are picked up
+	std::string name;
+	op.addOption("name",name,"A name");
+	const char* env5[]={"NAME=foo",nullptr};
+	op.parseEnvironment("",env5);
+	REQUIRE(name=="foo");
+	
+	//options which differ only in separators cannot be set unambiguously
+	op.addOption("dry_run",[&]{},"Do nothing, differently");
+	try{
+		op.parseEnvironment("MYTOOL_",env1);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		REQUIRE(std::string(ex.what())=="Environment variable MYTOOL_DRY_RUN corresponds to more than one option");
+	}
+	
+	setenv("CL_OPTIONS_TEST_THREADS","12",1);
+	op.parseEnvironment("CL_OPTIONS_TEST_");
+	REQUIRE(threads==12);
+	unsetenv("CL_OPTIONS_TEST_THREADS");
+}
+
+void test_response_files(){
+	int number=0;
+	bool flag=false;
+	OptionParser op;
+	op.addOption({"n","number"},number,"Set a number");
+	op.addOption('f',[&]{flag=true;},"Set a flag");
+	{
+		std::ofstream o1(".test_r1");
+		o1 << "first -n 2 'with space' @.test_r2\n\"last one\"";
+		std::ofstream o2(".test_r2");
+		o2 << "-f nested";
+	}
+	const char* args[]={"./program","@.test_r1","after","@"};
+	//not expanded unless enabled
+	auto positionals=op.parseArgs(4,args);
+	REQUIRE(positionals.size()==4 && positionals[1]=="@.test_r1");
+	REQUIRE(number==0 && !flag);
+	
+	op.allowsResponseFiles(true);
+	REQUIRE(op.allowsResponseFiles());
+	REQUIRE(op.getUsage().find(" @file: Read further arguments from file.\n")!=std::string::npos);
+	positionals=op.parseArgs(4,args);
+	REQUIRE(positionals.size()==7);
+	REQUIRE(positionals[0]=="./program");
+	REQUIRE(positionals[1]=="first");
+	REQUIRE(positionals[2]=="with space");
+	REQUIRE(positionals[3]=="nested");
+	REQUIRE(positionals[4]=="last one");
+	REQUIRE(positionals[5]=="after");
+	REQUIRE(positionals[6]=="@");
+	REQUIRE(number==2 && flag);
+	
+	//arguments after the terminator are left alone
+	op.allowsOptionTerminator(true);
+	const char* args2[]={"./program","--","@.test_r1"};
+	positionals=op.parseArgs(3,args2);
+	REQUIRE(positionals.size()==2 && positionals[1]=="@.test_r1");
+	
+	//loops are detected
+	{
+		std::ofstream o2(".test_r2");
+		o2 << "@.test_r1";
+	}
+	try{
+		op.parseArgs(2,args);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("Configuration file loop")!=std::string::npos);
+	}
+	
+	const char* args3[]={"./program","@.test_r_missing"};
+	try{
+		op.parseArgs(2,args3);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		REQUIRE(std::string(ex.what())=="Unable to read response file .test_r_missing");
+	}
+	unlink(".test_r1");
+	unlink(".test_r2");
+}
+
+struct JobSettings{
+	int threads=1;
+	std::string name;
+	bool verbose=false;
+};
+
+void test_target_parsing(){
+	OptionParser op;
+	op.usesANSICodes(false);
+	op.addOption({"t","threads"},&JobSettings::threads,"Number of threads","n");
+	op.addOption("name",&JobSettings::name,"Job name");
+	op.addTargetAction<JobSettings>('v',[](JobSettings& s){ s.verbose=true; },"Print more");
+	REQUIRE(op.getUsage().find("-t, --threads n")!=std::string::npos);
+	
+	const char* args[]={"job","-t","4","--name=build","-v","input"};
+	JobSettings settings;
+	//the parser must be frozen in advance
+	try{
+		op.parseArgs(settings,6,args);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& ex){}
+	op.freeze();
+	
+	const OptionParser& frozen=op;
+	auto positionals=frozen.parseArgs(settings,6,args);
+	REQUIRE(settings.threads==4 && settings.name=="build" && settings.verbose);
+	REQUIRE(positionals.size()==2 && positionals[1]=="input");
+	
+	//targets of the wrong type, or no target, are rejected
+	int wrongTarget;
+	try{
+		frozen.parseArgs(wrongTarget,6,args);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& ex){}
+	try{
+		op.parseArgs(6,args);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& ex){}
+	struct Other{ int x; };
+	try{
+		op.addOption("other",&Other::x,"Mismatched target");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& ex){}
+	
+	//help is reported per call, not through the parser
+	std::ostringstream help;
+	std::streambuf* oldBuf=std::cout.rdbuf(help.rdbuf());
+	const char* helpArgs[]={"job","--help"};
+	bool printedUsage=false;
+	frozen.parseArgs(settings,2,helpArgs,&printedUsage);
+	std::cout.rdbuf(oldBuf);
+	REQUIRE(printedUsage && !frozen.didPrintUsage());
+	REQUIRE(help.str().find("--threads")!=std::string::npos);
+	
+	//many threads can share one parser
+	const size_t nThreads=8, perThread=200;
+	std::vector<size_t> failures(nThreads,0);
+	std::vector<std::thread> workers;
+	for(size_t t=0; t<nThreads; t++){
+		workers.emplace_back([&,t]{
+			for(size_t i=0; i<perThread; i++){
+				std::string count=std::to_string(t*perThread+i);
+				std::string name="job"+count;
+				const char* jobArgs[]={"job","--threads",count.c_str(),"--name",name.c_str()};
+				JobSettings s;
+				auto pos=frozen.parseArgs(s,jobArgs,jobArgs+5);
+				if(s.threads!=(int)(t*perThread+i) || s.name!=name || s.verbose || pos.size()!=1)
+					failures[t]++;
+			}
+		});
+	}
+	for(auto& worker : workers)
+		worker.join();
+	for(size_t f : failures)
+		REQUIRE(f==0);
+}
+
+void test_batch_parsing(){
+	OptionParser op;
+	op.addOption({"t","threads"},&JobSettings::threads,"Number of threads","n");
+	op.addOption("name",&JobSettings::name,"Job name");
+	op.addTargetAction<JobSettings>('v',[](JobSettings& s){ s.verbose=true; },"Print more");
+	JobSettings prototype;
+	prototype.name="default";
+	try{
+		std::vector<std::string> lines;
+		op.parseBatch(lines.begin(),lines.end(),prototype);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& ex){}
+	op.freeze();
+	
+	//records given as collections of arguments
+	std::vector<std::vector<std::string>> argLists={
+		{"-t","2","in"},
+		{"--name","x","-v"},
+		{"-t","many"},
+	};
+	auto results=op.parseBatch(argLists.begin(),argLists.end(),prototype);
+	REQUIRE(results.size()==3);
+	REQUIRE(results[0].ok() && results[0].target.threads==2 && results[0].target.name=="default");
+	REQUIRE(results[0].positionals.size()==1 && results[0].positionals[0]=="in");
+	REQUIRE(results[1].ok() && results[1].target.name=="x" && results[1].target.verbose);
+	REQUIRE(results[1].target.threads==1 && results[1].positionals.empty());
+	REQUIRE(!results[2].ok() && results[2].error=="Failed to parse \"many\" as argument to 't' option");
+	
+	//a record requesting help is only noted, not printed
+	argLists={{"-t","3"},{"--help"}};
+	std::ostringstream help;
+	std::streambuf* oldBuf=std::cout.rdbuf(help.rdbuf());
+	results=op.parseBatch(argLists.begin(),argLists.end(),prototype);
+	std::cout.rdbuf(oldBuf);
+	REQUIRE(help.str().empty());
+	REQUIRE(results.size()==2 && results[0].ok() && results[1].ok());
+	REQUIRE(!results[0].printedUsage && results[1].printedUsage);
+	
+	//statistics are returned rather than written, even if the record fails
+	op.allowsStatisticsOption(true);
+	argLists={{"--cl-stats","-t","3"},{"--cl-stats","-t","many"},{"-t","4"}};
+	std::ostringstream report;
+	oldBuf=std::cerr.rdbuf(report.rdbuf());
+	results=op.parseBatch(argLists.begin(),argLists.end(),prototype);
+	std::cerr.rdbuf(oldBuf);
+	REQUIRE(report.str().empty());
+	REQUIRE(results.size()==3 && results[0].ok() && !results[1].ok() && results[2].ok());
+	REQUIRE(results[0].statistics && results[0].statistics->parses==1);
+	REQUIRE(results[1].statistics && results[1].statistics->parses==1);
+	REQUIRE(!results[2].statistics);
+	op.allowsStatisticsOption(false);
+	
+	//records given as lines of a manifest, enough to be spread over threads
+	//and read in several chunks
+	std::ostringstream manifest;
+	const size_t nRecords=40000;
+	for(size_t i=0; i<nRecords; i++){
+		if(i==500 || i==20000)
+			manifest << "--bogus\n";
+		else
+			manifest << "--threads " << i << " --name 'job " << i << "' input" << i << '\n';
+	}
+	std::istringstream manifestIn(manifest.str());
+	results=op.parseBatch(manifestIn,prototype);
+	REQUIRE(results.size()==nRecords);
+	for(size_t i=0; i<nRecords; i++){
+		if(i==500 || i==20000){
+			REQUIRE(!results[i].ok() && results[i].error=="Unknown option: '--bogus'");
+			continue;
+		}
+		REQUIRE(results[i].ok());
+		REQUIRE(results[i].target.threads==(int)i);
+		REQUIRE(results[i].target.name=="job "+std::to_string(i));
+		REQUIRE(results[i].positionals.size()==1 && results[i].positionals[0]=="input"+std::to_string(i));
+	}
+}
+
+void test_session(){
+	OptionParser op;
+	op.addOption({"t","threads"},&JobSettings::threads,"Number of threads","n");
+	op.addOption("name",&JobSettings::name,"Job name");
+	op.addTargetAction<JobSettings>('v',[](JobSettings& s){ s.verbose=true; },"Print more");
+	op.freeze();
+	OptionParser::Session session(op);
+	REQUIRE(session.capacity()==0);
+	
+	const char* args[]={"job","-t","3","--name","a rather long job name which will not fit in a short string","input"};
+	size_t capacity=0;
+	for(int i=0; i<10; i++){
+		JobSettings settings;
+		const auto& positionals=session.parse(settings,6,args);
+		REQUIRE(settings.threads==3 && settings.name==args[4]);
+		REQUIRE(positionals.size()==2 && positionals[0]=="job" && positionals[1]=="input");
+		REQUIRE(!session.printedUsage());
+		//after the first parse, the session's memory is simply reused
+		if(i==0)
+			capacity=session.capacity();
+		REQUIRE(capacity>0 && session.capacity()==capacity);
+	}
+	
+	JobSettings settings;
+	std::ostringstream help;
+	std::streambuf* oldBuf=std::cout.rdbuf(help.rdbuf());
+	session.parse(settings,"--help -v 'quoted positional'");
+	std::cout.rdbuf(oldBuf);
+	REQUIRE(session.printedUsage() && settings.verbose);
+	REQUIRE(session.positionals().size()==1 && session.positionals()[0]=="quoted positional");
+	session.parse(settings,"");
+	REQUIRE(!session.printedUsage() && session.positionals().empty());
+	
+	//errors leave the session usable
+	try{
+		session.parse(settings,"--threads lots");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){}
+	session.parse(settings,6,args);
+	REQUIRE(session.positionals().size()==2);
+	session.reset();
+	REQUIRE(session.positionals().empty());
+	
+	int wrongTarget;
+	try{
+		session.parse(wrongTarget,6,args);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& ex){}
+}
+
+void test_statistics(){
+	int number=0;
+	OptionParser op;
+	op.usesANSICodes(false);
+	op.addOption({"n","number"},number,"Set a number");
+	op.addOption('f',[]{ usleep(2000); },"A slow flag");
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-n 1 -c .test_c2";
+		std::ofstream o2(".test_c2");
+		o2 << "--number 2 -f";
+	}
+	OptionParser::ParseStatistics stats;
+	op.collectStatistics(&stats);
+	const char* args[]={"program","-f","--number=3","-c",".test_c1"};
+	op.parseArgs(5,args);
+	REQUIRE(number==2);
+	REQUIRE(stats.parses==1);
+	REQUIRE(stats.shortLookups==5 && stats.longLookups==2);
+	REQUIRE(stats.filesOpened==2 && stats.maxIncludeDepth==2);
+	REQUIRE(stats.bytesTokenized==16+13);
+	REQUIRE(stats.options.size()==4);
+	REQUIRE(stats.options[1].name=="n" && stats.options[1].uses==3);
+	REQUIRE(stats.options[2].name=="f" && stats.options[2].uses==2);
+	REQUIRE(stats.options[2].callbackSeconds>=0.004 && stats.callbackSeconds>=stats.options[2].callbackSeconds);
+	//storing a value involves no callback, only conversion
+	REQUIRE(stats.options[1].callbackSeconds==0 && stats.options[2].conversionSeconds<stats.options[2].callbackSeconds);
+	REQUIRE(stats.totalSeconds>=stats.callbackSeconds);
+	//statistics accumulate until collection stops
+	op.parseArgs(3,args);
+	REQUIRE(stats.parses==2 && stats.options[1].uses==4);
+	op.collectStatistics(nullptr);
+	op.parseArgs(3,args);
+	REQUIRE(stats.parses==2);
+	
+	//the hidden option is off by default
+	const char* statsArgs[]={"program","--cl-stats","--number=4"};
+	try{
+		op.parseArgs(3,statsArgs);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){}
+	op.allowsStatisticsOption(true);
+	REQUIRE(op.getUsage().find("cl-stats")==std::string::npos);
+	std::ostringstream report;
+	std::streambuf* oldBuf=std::cerr.rdbuf(report.rdbuf());
+	op.parseArgs(3,statsArgs);
+	const char* plainArgs[]={"program","--number=5"};
+	op.parseArgs(2,plainArgs);
+	std::cerr.rdbuf(oldBuf);
+	REQUIRE(number==5);
+	//statistics are collected from the point where the option appears
+	REQUIRE(report.str().find("Option parsing statistics (1 parse):\n")==0);
+	REQUIRE(report.str().find("  lookups: 0 short, 1 long, 0 environment\n")!=std::string::npos);
+	REQUIRE(report.str().find("  n: 1 use, ")!=std::string::npos);
+	REQUIRE(report.str().rfind("Option parsing statistics")==0);
+	
+	//a parse which fails is still reported
+	report.str("");
+	oldBuf=std::cerr.rdbuf(report.rdbuf());
+	const char* failingArgs[]={"program","--cl-stats","-c",".test_c1","--bogus"};
+	try{
+		op.parseArgs(5,failingArgs);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){}
+	std::cerr.rdbuf(oldBuf);
+	REQUIRE(report.str().find("  files: 2 opened, ")!=std::string::npos);
+	
+	//as are parses with a target object, which do not share statistics
+	OptionParser targetParser(false);
+	targetParser.addOption({"n","number"},&JobSettings::threads,"Set a number");
+	targetParser.allowsStatisticsOption(true);
+	targetParser.freeze();
+	JobSettings job;
+	report.str("");
+	oldBuf=std::cerr.rdbuf(report.rdbuf());
+	targetParser.parseArgs(job,3,statsArgs);
+	std::cerr.rdbuf(oldBuf);
+	REQUIRE(job.threads==4);
+	REQUIRE(report.str().find("  n: 1 use, 0 s in callbacks, ")!=std::string::npos);
+	unlink(".test_c1");
+	unlink(".test_c2");
+}
+
+void test_parse_limits(){
+	size_t flags=0;
+	std::string name;
+	OptionParser op;
+	op.addOption('v',[&]{flags++;},"Set a flag");
+	op.addOption("name",name,"Set a name");
+	op.addConfigFileOption('c',"Read config from a file");
+	op.allowsShortOptionCombination(true);
+	
+	//combined groups of any length are handled without recursion
+	std::string group="-"+std::string(1000000,'v');
+	const char* groupArgs[]={"program",group.c_str()};
+	op.parseArgs(2,groupArgs);
+	REQUIRE(flags==1000000);
+	
+	REQUIRE(op.maxTokenLength()==std::numeric_limits<size_t>::max());
+	op.maxTokenLength(8);
+	const char* longArgs[]={"program","--name","longer than 8"};
+	try{
+		op.parseArgs(3,longArgs);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("longer than the limit of 8")!=std::string::npos);
+	}
+	//the tokenizer stops reading as soon as the limit is passed
+	std::istringstream ss("--name '"+std::string(1000,'x')+"'");
+	try{
+		op.parseArgsFromStream(ss);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){}
+	REQUIRE(ss.tellg()<100);
+	//values from the environment are limited as well
+	const char* longEnvironment[]={"LIMIT_NAME=longer than 8",nullptr};
+	try{
+		op.parseEnvironment("LIMIT_",longEnvironment);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("longer than the limit of 8")!=std::string::npos);
+	}
+	//and so are files, directories, and response files, including a token
+	//which runs to the end of the file
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "--name " << std::string(100000,'x');
+	}
+	REQUIRE(mkdir(".test_d",0755)==0);
+	REQUIRE(link(".test_c1",".test_d/a.conf")==0);
+	op.allowsResponseFiles(true);
+	const char* responseArgs[]={"program","@.test_c1"};
+	for(unsigned int i=0; i<3; i++){
+		try{
+			if(i==0)
+				op.parseArgsFromFile(".test_c1");
+			else if(i==1)
+				op.parseArgsFromFile(".test_d");
+			else
+				op.parseArgs(2,responseArgs);
+			REQUIRE(false && "An exception should be thrown");
+		}catch(std::runtime_error& ex){
+			std::string err=ex.what();
+			REQUIRE(err.find("longer than the limit of 8")!=std::string::npos);
+			//the file within the directory is identified
+			if(i==1)
+				REQUIRE(err.find(".test_d/a.conf")!=std::string::npos);
+		}
+	}
+	op.allowsResponseFiles(false);
+	op.maxTokenLength(std::numeric_limits<size_t>::max());
+	
+	op.maxArgumentCount(3);
+	op.parseArgs(3,longArgs);
+	REQUIRE(name=="longer than 8");
+	const char* manyArgs[]={"program","a","b","c"};
+	try{
+		op.parseArgs(4,manyArgs);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("Too many arguments")!=std::string::npos);
+	}
+	op.maxArgumentCount(1);
+	const char* environment[]={"LIMIT_NAME=x","OTHER=y","LIMIT_NAME=z",nullptr};
+	try{
+		op.parseEnvironment("LIMIT_",environment);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("Too many arguments")!=std::string::npos);
+	}
+	//files are rejected while they are tokenized
+	op.maxArgumentCount(3);
+	{
+		std::ofstream o1(".test_c1");
+		for(unsigned int i=0; i<1000; i++)
+			o1 << "a ";
+	}
+	try{
+		op.parseArgsFromFile(".test_c1");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("Too many arguments")!=std::string::npos);
+	}
+	unlink(".test_d/a.conf");
+	rmdir(".test_d");
+	op.maxArgumentCount(std::numeric_limits<size_t>::max());
+	
+	REQUIRE(op.maxIncludeDepth()==64);
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-c .test_c2";
+		std::ofstream o2(".test_c2");
+		o2 << "-c .test_c3";
+		std::ofstream o3(".test_c3");
+		o3 << "-v";
+	}
+	op.maxIncludeDepth(2);
+	try{
+		op.parseArgsFromFile(".test_c1");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& ex){
+		std::string err=ex.what();
+		REQUIRE(err.find("nested more than 2 deep")!=std::string::npos);
+	}
+	op.maxIncludeDepth(3);
+	op.parseArgsFromFile(".test_c1");
+	unlink(".test_c1");
+	unlink(".test_c2");
+	unlink(".test_c3");
+}
+
+void test_config_watcher(){
+	int number=0, numberSets=0, nameSets=0;
+	bool fSet=false;
+	OptionParser op;
+	op.addOption({"n","number"},std::function<void(int)>([&](int n){ number=n; numberSets++; }),"Set a number");
+	op.addOption("name",std::function<void(std::string)>([&](std::string){ nameSets++; }),"Set a name");
+	op.addOption('f',[&]{fSet=true;},"Set a flag");
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-n 1 -c .test_c2 positional";
+		std::ofstream o2(".test_c2");
+		o2 << "--name foo";
+	}
+	ConfigWatcher watcher(op,".test_c1");
+	REQUIRE(number==1 && numberSets==1 && nameSets==1 && !fSet);
+	REQUIRE(watcher.positionals().size()==1 && watcher.positionals()[0]=="positional");
+	REQUIRE(watcher.files().size()==2);
+	
+	//nothing has changed
+	ConfigWatcher::ReloadResult result=watcher.reload();
+	REQUIRE(result.reloaded && result.error.empty() && result.changedOptions.empty());
+	REQUIRE(numberSets==1 && nameSets==1);
+	
+	//change one option, using a synonym, and add a flag
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "--number 2 -c .test_c2 -f positional";
+	}
+	result=watcher.poll();
+	REQUIRE(result.reloaded && result.error.empty());
+	REQUIRE(result.changedOptions.size()==2);
+	REQUIRE(number==2 && numberSets==2 && nameSets==1 && fSet);
+#ifdef __linux__
+	REQUIRE(watcher.fileDescriptor()>=0);
+	//no further events, so nothing to do
+	result=watcher.poll();
+	REQUIRE(!result.reloaded);
+#endif
+	
+	//an invalid configuration is reported and not applied
+	{
+		std::ofstream o2(".test_c2");
+		o2 << "--name bar --bogus";
+	}
+	result=watcher.poll();
+	REQUIRE(result.reloaded==false && !result.error.empty());
+	REQUIRE(nameSets==1);
+	
+	//once fixed, only the changed option is applied
+	{
+		std::ofstream o2(".test_c2");
+		o2 << "--name bar";
+	}
+	result=watcher.poll();
+	REQUIRE(result.reloaded && result.changedOptions.size()==1 && result.changedOptions[0]=="name");
+	REQUIRE(numberSets==2 && nameSets==2);
+	unlink(".test_c1");
+	unlink(".test_c2");
+}
+
+void test_config_watcher_bad_value(){
+	int a=0, n=0, b=0;
+	OptionParser op;
+	op.addOption('a',a,"Set a");
+	op.addOption('n',n,"Set n");
+	op.addOption('b',b,"Set b");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-a 1 -n 1 -b 1";
+	}
+	ConfigWatcher watcher(op,".test_c1");
+	REQUIRE(a==1 && n==1 && b==1);
+	
+	//a value which cannot be converted prevents every change being applied
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-a 2 -n bad -b 2";
+	}
+	ConfigWatcher::ReloadResult result=watcher.reload();
+	REQUIRE(!result.reloaded && !result.error.empty() && result.changedOptions.empty());
+	REQUIRE(a==1 && n==1 && b==1);
+	
+	//once fixed, every change is applied
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-a 2 -n 3 -b 2";
+	}
+	result=watcher.reload();
+	REQUIRE(result.reloaded && result.error.empty() && result.changedOptions.size()==3);
+	REQUIRE(a==2 && n==3 && b==2);
+	unlink(".test_c1");
+}
+
+void test_config_watcher_repeated_uses(){
+	unsigned int verbosity=0;
+	std::vector<std::string> names;
+	OptionParser op;
+	op.addOption('v',[&]{verbosity++;},"Be more verbose");
+	op.addOption("name",std::function<void(std::string)>([&](std::string n){ names.push_back(n); }),"Add a name");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-v -v --name a --name b";
+	}
+	ConfigWatcher watcher(op,".test_c1");
+	REQUIRE(verbosity==2 && names.size()==2);
+	
+	//using a flag a different number of times is a change
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-v --name a --name b";
+	}
+	ConfigWatcher::ReloadResult result=watcher.reload();
+	REQUIRE(result.reloaded && result.changedOptions.size()==1 && result.changedOptions[0]=="v");
+	REQUIRE(verbosity==3 && names.size()==2);
+	
+	//as is changing any value of an option, not just its last, and all of 
+	//the option's values are replayed
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-v --name c --name b";
+	}
+	result=watcher.reload();
+	REQUIRE(result.reloaded && result.changedOptions.size()==1 && result.changedOptions[0]=="name");
+	REQUIRE(verbosity==3 && names.size()==4 && names[2]=="c" && names[3]=="b");
+	unlink(".test_c1");
+}
+
+void test_freeze(){
+	OptionParser op;
+	bool fSet=false, gSet=false;
+	int i=0;
+	op.addOption('f',[&]{fSet=true;},"Set a flag");
+	op.addOption("integer",i,"Set an integer");
+	REQUIRE(!op.isFrozen());
+	op.freeze();
+	REQUIRE(op.isFrozen());
+	const char* args[]={"program","-f","--integer=5","-g"};
+	op.parseArgs(3,args);
+	REQUIRE(fSet);
+	REQUIRE(i==5);
+	//adding an option after freezing should make it visible to the next parse
+	op.addOption('g',[&]{gSet=true;},"Set another flag");
+	REQUIRE(!op.isFrozen());
+	op.parseArgs(4,args);
+	REQUIRE(gSet);
+	REQUIRE(op.isFrozen());
+	//redefining an option is an error, whether short or long
+	try{
+		op.addOption('f',[&]{},"Set a flag again");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& err){}
+	try{
+		op.addOption("integer",i,"Set an integer again");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& err){}
+	//a set of synonyms containing a name in use registers none of them
+	try{
+		op.addOption({"x","integer"},i,"Set an integer again");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& err){}
+	try{
+		op.addOption({"y","y"},i,"Set an integer again");
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::logic_error& err){}
+	op.addOption({"x","y"},i,"Set an integer again");
+	//which share a single handler
+	const size_t handlers=cl_options_test_access::handlerCount(op);
+	op.addOption({"a","alpha","first"},std::function<void()>([&]{}),"Synonyms");
+	REQUIRE(cl_options_test_access::handlerCount(op)==handlers+1);
+	//a long option sharing its first letter with a short option is distinct from it
+	bool longGSet=false;
+	op.addOption("gg",[&]{longGSet=true;},"A long flag");
+	const char* args2[]={"program","--gg"};
+	gSet=false;
+	op.parseArgs(2,args2);
+	REQUIRE(longGSet);
+	REQUIRE(!gSet);
+}
+
+void test_short_option_table(){
+	OptionParser op(false);
+	op.allowsShortOptionCombination(true);
+	std::string seen;
+	//characters outside of ASCII index the table like any others
+	for(char c : std::string("abcxyz\xe9"))
+		op.addOption(c,[&seen,c]{seen+=c;},"A flag");
+	const char* args[]={"program","-zxa","-\xe9","-b"};
+	op.parseArgs(4,args);
+	REQUIRE(seen=="zxa\xe9" "b");
+	const char* badArgs[]={"program","-\xe8"};
+	try{
+		op.parseArgs(2,badArgs);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& err){}
+}
+
+void test_stream_values(){
+	std::string name;
+	int number=0;
+	OptionParser op;
+	op.addOption("name",name,"Set a name");
+	op.addOption('i',number,"Set an integer");
+	std::istringstream iss("program --name 'baz quux' -i 12 foo");
+	std::vector<std::string> positionals=op.parseArgsFromStream(iss);
+	REQUIRE(positionals.size()==2 && positionals[1]=="foo");
+	REQUIRE(name=="baz quux");
+	REQUIRE(number==12);
+	//the argument lacking a value must still be reported after the token
+	//stream has moved past it
+	std::istringstream iss2("program --name");
+	try{
+		op.parseArgsFromStream(iss2);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& err){
+		REQUIRE(std::string(err.what())=="Missing value for '--name'");
+	}
+}
+
+//A stateful allocator which counts the allocations made through it
+template<typename T>
+struct CountingAllocator{
+	using value_type=T;
+	size_t* count;
+	explicit CountingAllocator(size_t* c):count(c){}
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U>& other):count(other.count){}
+	T* allocate(size_t n){
+		++*count;
+		return(std::allocator<T>().allocate(n));
+	}
+	void deallocate(T* p, size_t n){ std::allocator<T>().deallocate(p,n); }
+	template<typename U>
+	bool operator==(const CountingAllocator<U>& other) const{ return(count==other.count); }
+	template<typename U>
+	bool operator!=(const CountingAllocator<U>& other) const{ return(count!=other.count); }
+};
+
+void test_allocator(){
+	int number=0;
+	OptionParser op;
+	op.addOption("integer",number,"Set an integer");
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "--integer 17 'a positional argument read from the file'";
+	}
+	op.freeze();
+	size_t count=0;
+	CountingAllocator<char> alloc(&count);
+	const char* args[]={"program","foo","-c",".test_c1","a positional argument long enough to allocate"};
+	auto positionals=op.parseArgs(5,args,alloc);
+	unlink(".test_c1");
+	REQUIRE(positionals.size()==4);
+	REQUIRE(positionals[2]=="a positional argument read from the file");
+	REQUIRE(positionals[3]=="a positional argument long enough to allocate");
+	REQUIRE(positionals.get_allocator().count==&count);
+	REQUIRE(positionals[3].get_allocator().count==&count);
+	REQUIRE(number==17);
+	REQUIRE(count>0);
+	
+	count=0;
+	std::istringstream iss("program --integer 22 'another positional argument which is long'");
+	positionals=op.parseArgsFromStream(iss,alloc);
+	REQUIRE(positionals.size()==2);
+	REQUIRE(positionals[1]=="another positional argument which is long");
+	REQUIRE(number==22);
+	REQUIRE(count>0);
+}
+
+void test_positional_views(){
+	int number=0;
+	OptionParser op;
+	op.addOption("integer",number,"Set an integer");
+	op.addConfigFileOption('c',"Read config from a file");
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "--integer 17";
+		for(unsigned int i=0; i<1000; i++)
+			o1 << " file" << i;
+	}
+	const char* args[]={"program","foo","-c",".test_c1","bar"};
+	OptionParser::PositionalViews views=op.parseArgsAsViews(5,args);
+	REQUIRE(number==17);
+	REQUIRE(views.size()==1003);
+	//arguments passed directly are not copied
+	REQUIRE(views[0].data()==args[0]);
+	REQUIRE(views[1].data()==args[1]);
+	REQUIRE(views[1002].data()==args[4]);
+	//arguments from the file survive the file being closed, and the result 
+	//being moved
+	OptionParser::PositionalViews moved=std::move(views);
+	for(unsigned int i=0; i<1000; i++)
+		REQUIRE(moved[i+2]==("file"+std::to_string(i)));
+	
+	OptionParser::PositionalViews fromFile=op.parseArgsFromFileAsViews(".test_c1");
+	unlink(".test_c1");
+	REQUIRE(fromFile.size()==1000);
+	REQUIRE(fromFile[999]=="file999");
+	
+	//arguments from iterators which reuse their buffers are copied
+	std::istringstream ss("alpha beta gamma");
+	OptionParser::PositionalViews fromStream=op.parseArgsAsViews(std::istream_iterator<std::string>(ss),
+	                                                             std::istream_iterator<std::string>());
+	REQUIRE(fromStream.size()==3);
+	REQUIRE(fromStream[0]=="alpha" && fromStream[1]=="beta" && fromStream[2]=="gamma");
+	const char* byValue[]={"a positional which is longer than a short string","another long positional"};
+	OptionParser::PositionalViews fromValues=op.parseArgsAsViews(ByValueIterator{byValue},ByValueIterator{byValue+2});
+	REQUIRE(fromValues.size()==2);
+	REQUIRE(fromValues[0]==byValue[0] && fromValues[0].data()!=byValue[0]);
+	REQUIRE(fromValues[1]==byValue[1]);
+}
+
+void test_option_handler(){
+	using OptionHandler=cl_options_test_access::OptionHandler;
+	std::string seen;
+	//small enough to be stored inline
+	OptionHandler small=OptionHandler::make([&seen](void*, OptionParser::StringView v){
+		seen=v.str();
+		return(true);
+	});
+	//too large to be stored inline
+	std::array<char,256> padding;
+	padding.fill('x');
+	OptionHandler large=OptionHandler::make([&seen,padding](void*, OptionParser::StringView v){
+		seen=v.str()+padding[255];
+		return(v.size()>1);
+	});
+	OptionHandler smallCopy(small), largeCopy(large);
+	OptionHandler smallMoved(std::move(small)), largeMoved(std::move(large));
+	REQUIRE(smallCopy(nullptr,"a") && seen=="a");
+	REQUIRE(smallMoved(nullptr,"b") && seen=="b");
+	REQUIRE(largeCopy(nullptr,"cd") && seen=="cdx");
+	REQUIRE(!largeMoved(nullptr,"e") && seen=="ex");
+	smallCopy=largeMoved;
+	REQUIRE(smallCopy(nullptr,"fg") && seen=="fgx");
+	largeMoved=smallMoved;
+	REQUIRE(largeMoved(nullptr,"h") && seen=="h");
+}
+
+void test_usage(){
+	OptionParser op(false);
+	op.usesANSICodes(false);
+	int number=5;
+	bool flag=false;
+	op.addOption({"n","number"},number,"Set a number","n");
+	op.addOption('f',[&]{flag=true;},"Set a flag\nwith more description");
+	number=7;
+	op.setBaseUsage("Usage: program [options]");
+	op.allowsOptionTerminator(true);
+	op.allowsOptionTerminator(true);
+	std::string expected="Usage: program [options]\n"
+	" -n, --number n: Set a number\n    (default: 5)\n"
+	" -f: Set a flag\n    with more description\n"
+	" --: Treat all subsequent arguments as positional.\n";
+	REQUIRE(op.getUsage()==expected);
+	//the rendered text must be updated when more options are added
+	std::string name="x";
+	op.addOption("name",name,"Set a name");
+	expected.insert(expected.rfind(" --:")," --name value: Set a name\n    (default: \"x\")\n");
+	REQUIRE(op.getUsage()==expected);
+	op.allowsOptionTerminator(false);
+	REQUIRE(op.getUsage().find(" --:")==std::string::npos);
+}
+
+void test_usage_wrapping(){
+	OptionParser op(false);
+	op.usesANSICodes(true);
+	std::string file;
+	op.addOption("input",file,"Read input from the specified file, which must exist and be readable","file");
+	op.addOption('v',[]{},"Be verbose\nextremely verbose, printing everything");
+	op.addOption('x',[]{},"Unbreakable_word_which_is_much_longer_than_the_width");
+	std::string expected=
+	" --input \x1B[4mfile\x1B[24m: Read input from the\n"
+	"    specified file, which must\n"
+	"    exist and be readable\n"
+	"    (default: \"\")\n"
+	" -v: Be verbose\n"
+	"    extremely verbose, printing\n"
+	"    everything\n"
+	" -x:\n"
+	"    Unbreakable_word_which_is_much_longer_than_the_width\n";
+	REQUIRE(op.getUsage(34)==expected);
+	//unwrapped text is unchanged
+	REQUIRE(op.getUsage().find("Read input from the specified file, which must exist and be readable\n")!=std::string::npos);
+	REQUIRE(OptionParser::terminalWidth()>0);
+}
+
+void test_file_contents(){
+	using FileContents=cl_options_test_access::FileContents;
+	{
+		std::ofstream o1(".test_c1");
+		o1 << "-f -c .test_c2";
+		std::ofstream o2(".test_c2");
+	}
+	{
+		FileContents contents;
+		REQUIRE(contents.load(".test_c1"));
+		REQUIRE(std::string(contents.begin(),contents.end())=="-f -c .test_c2");
+	}
+	{
+		FileContents contents;
+		REQUIRE(contents.load(".test_c2"));
+		REQUIRE(contents.begin()==contents.end());
+	}
+	unlink(".test_c1");
+	unlink(".test_c2");
+	FileContents missing;
+	REQUIRE(!missing.load(".test_c1"));
+	FileContents directory;
+	REQUIRE(!directory.load("."));
+	
+	//a large file, which is mapped into memory
+	int number=0;
+	unsigned int count=0;
+	OptionParser op;
+	op.addOption('n',number,"Set a number");
+	op.addOption("count",std::function<void()>([&]{count++;}),"Count");
+	{
+		std::ofstream o1(".test_c1");
+		for(unsigned int i=0; i<50000; i++)
+			o1 << "--count -n " << i << '\n';
+	}
+	std::vector<std::string> positionals=op.parseArgsFromFile(".test_c1");
+	unlink(".test_c1");
+	REQUIRE(positionals.empty());
+	REQUIRE(count==50000);
+	REQUIRE(number==49999);
+	
+	//the same through a pipe, which cannot be mapped and is too large to be
+	//read in a single chunk
+	REQUIRE(mkfifo(".test_fifo",0600)==0);
+	std::thread writer([]{
+		std::ofstream out(".test_fifo");
+		for(unsigned int i=0; i<50000; i++)
+			out << "--count -n " << i << '\n';
+	});
+	count=0;
+	number=0;
+	positionals=op.parseArgsFromFile(".test_fifo");
+	writer.join();
+	unlink(".test_fifo");
+	REQUIRE(positionals.empty());
+	REQUIRE(count==50000);
+	REQUIRE(number==49999);
+}
+
+struct Coordinate{
+	int x, y;
+};
+template<>
+struct OptionValueConverter<Coordinate>{
+	static bool convert(const char* begin, const char* end, Coordinate& c){
+		std::string s(begin,end);
+		size_t comma=s.find(',');
+		return(comma!=std::string::npos
+		       && OptionValueConverter<int>::convert(begin,begin+comma,c.x)
+		       && OptionValueConverter<int>::convert(begin+comma+1,end,c.y));
+	}
+};
+std::ostream& operator<<(std::ostream& os, const Coordinate& c){
+	return(os << c.x << ',' << c.y);
+}
+struct Temperature{
+	double degrees;
+};
+std::istream& operator>>(std::istream& is, Temperature& t){
+	is >> t.degrees;
+	char unit;
+	if(is >> unit && unit!='C')
+		is.setstate(std::ios::failbit);
+	return(is);
+}
+
+//a type which can be read and shown, but not copied
+struct Tally{
+	int count;
+	Tally():count(0){}
+	Tally(const Tally&)=delete;
+	Tally& operator=(const Tally&)=delete;
+};
+std::istream& operator>>(std::istream& is, Tally& t){
+	return(is >> t.count);
+}
+std::ostream& operator<<(std::ostream& os, const Tally& t){
+	return(os << t.count << " so far");
+}
+
+//a type which counts how often values of it are shown
+struct Shown{
+	int value;
+	static unsigned int timesShown;
+};
+unsigned int Shown::timesShown=0;
+std::istream& operator>>(std::istream& is, Shown& s){
+	return(is >> s.value);
+}
+std::ostream& operator<<(std::ostream& os, const Shown& s){
+	Shown::timesShown++;
+	return(os << s.value);
+}
+
+template<typename T>
+bool convertsTo(std::string text, T expected){
+	T value;
+	return(OptionValueConverter<T>::convert(text.data(),text.data()+text.size(),value) && value==expected);
+}
+template<typename T>
+bool rejects(std::string text){
+	T value;
+	return(!OptionValueConverter<T>::convert(text.data(),text.data()+text.size(),value));
+}
+
+void test_value_conversion(){
+	REQUIRE(convertsTo<int>("52",52));
+	REQUIRE(convertsTo<int>("+52",52));
+	REQUIRE(convertsTo<int>("-2147483648",std::numeric_limits<int>::min()));
+	REQUIRE(convertsTo<int>("2147483647",std::numeric_limits<int>::max()));
+	REQUIRE(rejects<int>("2147483648"));
+	REQUIRE(rejects<int>("-2147483649"));
+	REQUIRE(rejects<int>("52abc"));
+	REQUIRE(rejects<int>(""));
+	REQUIRE(rejects<int>("-"));
+	REQUIRE(rejects<int>("+-5"));
+	REQUIRE(convertsTo<unsigned long long>("18446744073709551615",std::numeric_limits<unsigned long long>::max()));
+	REQUIRE(rejects<unsigned long long>("18446744073709551616"));
+	REQUIRE(rejects<unsigned int>("-1"));
+	REQUIRE(convertsTo<short>("-32768",std::numeric_limits<short>::min()));
+	REQUIRE(rejects<short>("32768"));
+	REQUIRE(convertsTo<double>("2.5",2.5));
+	REQUIRE(convertsTo<double>("-1e3",-1000.0));
+	REQUIRE(convertsTo<float>("+0.25",0.25f));
+	REQUIRE(rejects<double>("1.5x"));
+	REQUIRE(rejects<double>(" 1.5"));
+	REQUIRE(rejects<double>("1e999"));
+	REQUIRE(rejects<double>(""));
+	REQUIRE(convertsTo<double>(".5",0.5));
+	REQUIRE(convertsTo<double>("5.",5.0));
+	REQUIRE(convertsTo<double>("1E2",100.0));
+	REQUIRE(convertsTo<double>("-Infinity",-std::numeric_limits<double>::infinity()));
+	REQUIRE(convertsTo<float>("inf",std::numeric_limits<float>::infinity()));
+	{
+		double nan=0;
+		REQUIRE(OptionValueConverter<double>::convert("nan",(const char*)"nan"+3,nan) && std::isnan(nan));
+	}
+	//the same forms are accepted with and without from_chars
+	REQUIRE(rejects<double>("0x1p4"));
+	REQUIRE(rejects<double>("0x10"));
+	REQUIRE(rejects<double>("1e"));
+	REQUIRE(rejects<double>("."));
+	REQUIRE(rejects<double>("infinit"));
+	REQUIRE(rejects<double>("1,5"));
+	REQUIRE(convertsTo<bool>("true",true));
+	REQUIRE(convertsTo<bool>("false",false));
+	REQUIRE(rejects<bool>("1"));
+	REQUIRE(rejects<bool>("truely"));
+	REQUIRE(convertsTo<char>("x",'x'));
+	REQUIRE(rejects<char>("xy"));
+	REQUIRE(convertsTo<std::string>("baz quux","baz quux"));
+	REQUIRE(convertsTo<std::string>("",""));
+	
+	//types without a specialization are read from a stream
+	Temperature t;
+	std::string text="21.5C";
+	REQUIRE(OptionValueConverter<Temperature>::convert(text.data(),text.data()+text.size(),t) && t.degrees==21.5);
+	text="21.5F";
+	REQUIRE(!OptionValueConverter<Temperature>::convert(text.data(),text.data()+text.size(),t));
+	
+	//specializations are used by options
+	OptionParser op;
+	Coordinate c{0,0};
+	std::string name;
+	op.addOption("position",c,"Set a position");
+	op.addOption("name",name,"Set a name");
+	const char* args[]={"program","--position=3,-4","--name","Edgar Allan Poe"};
+	op.parseArgs(4,args);
+	REQUIRE(c.x==3 && c.y==-4);
+	REQUIRE(name=="Edgar Allan Poe");
+	const char* badArgs[]={"program","--position=3"};
+	try{
+		op.parseArgs(2,badArgs);
+		REQUIRE(false && "An exception should be thrown");
+	}catch(std::runtime_error& err){}
+}
+
+struct StaticSettings{
+	bool fSet=false, gSet=false;
+	int number=0;
+	std::string name;
+	unsigned int resets=0;
+};
+void resetStaticSettings(StaticSettings& s){ s.resets++; }
+struct StaticSettingsSchema{
+	using Target=StaticSettings;
+	static constexpr StaticOption<StaticSettings> options[]={
+		StaticOption<StaticSettings>::flag<&StaticSettings::fSet>("f","Set a flag"),
+		StaticOption<StaticSettings>::flag<&StaticSettings::gSet>("g","Set another flag"),
+		StaticOption<StaticSettings>::value<int,&StaticSettings::number>("integer","Set an integer","n"),
+		StaticOption<StaticSettings>::value<std::string,&StaticSettings::name>("n","A name"),
+		StaticOption<StaticSettings>::action<&resetStaticSettings>("reset","Count resets"),
+	};
+};
+
+void test_non_copyable_destination(){
+	OptionParser op(false);
+	op.usesANSICodes(false);
+	Tally tally;
+	tally.count=3;
+	op.addOption({"t","tally"},tally,"Set the tally","n");
+	tally.count=4;
+	//the default is the value when the option was added
+	REQUIRE(op.getUsage()==" -t, --tally n: Set the tally\n    (default: 3 so far)\n");
+	const char* args[]={"program","--tally=12"};
+	op.parseArgs(2,args);
+	REQUIRE(tally.count==12);
+}
+
+void test_lazy_defaults(){
+	OptionParser op(false);
+	op.usesANSICodes(false);
+	Shown shown{5};
+	op.addOption('s',shown,"Set a value","n");
+	shown.value=6;
+	//defaults are copied, but not formatted until the help text is needed
+	REQUIRE(Shown::timesShown==0);
+	REQUIRE(op.getUsage()==" -s n: Set a value\n    (default: 5)\n");
+	REQUIRE(Shown::timesShown==1);
+}
+
+void test_static_parser(){
+	StaticOptionParser<StaticSettingsSchema> op;
+	StaticSettings settings;
+	const char* args[]={"program","foo","-f","--integer","17","-n=Edgar","--reset","bar","--reset"};
+	std::vector<std::string> positionals=op.parseArgs(settings,9,args);
+	REQUIRE(positionals.size()==3);
+	REQUIRE(settings.fSet);
+	REQUIRE(!settings.gSet);
+	REQUIRE(settings.number==17);
+	REQUIRE(settings.name=="Edgar");
+	REQUIRE(settings.resets==2);
+	
+	const char* badArgs[][2]={{"program","-x"},{"program","--integer=x"},{"program","--integer"},
+	                          {"program","-fg"},{"program","--f"},{"program","--reset=1"}};
+	for(auto badArg : badArgs){
+		try{
+			op.parseArgs(settings,2,badArg);
+			REQUIRE(false && "An exception should be thrown");
+		}catch(std::runtime_error& err){}
+	}
+	
+	op.allowsShortOptionCombination(true);
+	op.allowsOptionTerminator(true);
+	settings=StaticSettings();
+	const char* args2[]={"program","-gfn","Edgar","--","-f"};
+	positionals=op.parseArgs(settings,5,args2);
+	REQUIRE(positionals.size()==2 && positionals.back()=="-f");
+	REQUIRE(settings.fSet);
+	REQUIRE(settings.gSet);
+	REQUIRE(settings.name=="Edgar");
+	
+	REQUIRE(op.getUsage().find(" --integer n: Set an integer\n")!=std::string::npos);
+	
+	//arguments from an iterator which returns them by value
+	settings=StaticSettings();
+	const char* args3[]={"-n","a name which is longer than a short string",
+	                     "a positional which is longer than a short string","--","-f"};
+	positionals=op.parseArgs(settings,ByValueIterator{args3},ByValueIterator{args3+5});
+	REQUIRE(settings.name=="a name which is longer than a short string");
+	REQUIRE(positionals.size()==2 && positionals[0]=="a positional which is longer than a short string");
+	REQUIRE(positionals[1]=="-f" && !settings.fSet);
+}
+
 #define DO_TEST(test) \
 	do{ \
 	try{ \
@@ -525,12 +2048,42 @@ int main(){
 	DO_TEST(test_positionals);
 	DO_TEST(test_positionals_and_options);
 	DO_TEST(test_option_terminator);
+	DO_TEST(test_by_value_iterator);
 	DO_TEST(test_token_iterator);
+	DO_TEST(test_contiguous_token_iterator);
+	DO_TEST(test_empty_quoted_tokens);
 	DO_TEST(test_positionals_and_options_from_stream);
+	DO_TEST(test_stream_values);
+	DO_TEST(test_allocator);
+	DO_TEST(test_positional_views);
+	DO_TEST(test_option_handler);
+	DO_TEST(test_usage);
+	DO_TEST(test_usage_wrapping);
+	DO_TEST(test_file_contents);
 	DO_TEST(test_config_file_parsing_short_option);
 	DO_TEST(test_config_file_parsing_long_option);
 	DO_TEST(test_config_file_parsing_short_and_long_options);
 	DO_TEST(test_config_file_parsing_loop);
+	DO_TEST(test_config_file_parsing_symlink_loop);
+	DO_TEST(test_config_file_repeated_include);
+	DO_TEST(test_config_file_snapshot);
+	DO_TEST(test_config_directory);
+	DO_TEST(test_config_watcher);
+	DO_TEST(test_config_watcher_bad_value);
+	DO_TEST(test_config_watcher_repeated_uses);
+	DO_TEST(test_environment);
+	DO_TEST(test_response_files);
+	DO_TEST(test_target_parsing);
+	DO_TEST(test_batch_parsing);
+	DO_TEST(test_session);
+	DO_TEST(test_statistics);
+	DO_TEST(test_parse_limits);
+	DO_TEST(test_freeze);
+	DO_TEST(test_short_option_table);
+	DO_TEST(test_static_parser);
+	DO_TEST(test_value_conversion);
+	DO_TEST(test_non_copyable_destination);
+	DO_TEST(test_lazy_defaults);
 	
 	if(!failures)
 		std::cout << "Test successful" << std::endl;